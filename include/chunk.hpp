@@ -62,6 +62,23 @@ namespace hCraft {
 	};
 	
 	
+	/* 
+	 * The stages a chunk goes through from the moment it is created and until
+	 * it can be safely sent to players.
+	 */
+	enum chunk_status
+	{
+		CS_EMPTY = 0,  // allocated, might hold blocks spilled over from neighbours.
+		CS_TERRAIN,    // base terrain generated.
+		CS_DECORATED,  // decorations (trees, plants, etc...) placed.
+		CS_LIT,        // heightmap and lighting calculated.
+		
+		// lit, and all eight neighbours are decorated, which means that no more
+		// blocks are going to be placed into this chunk by the world generator.
+		CS_READY,
+	};
+	
+	
 	/* 
 	 * Every chunk is made out of 16 subchunks, each being 16x16x16 in size.
 	 */
@@ -74,11 +91,29 @@ namespace hCraft {
 		unsigned char *add;
 		int add_count;
 		int air_count;
+		int phys_count; // number of blocks with physics IDs
+		
+		// IDs that have physics blocks attached to them (in any world).
+		static bool physics_ids[4096];
 		
 	//----
 	
 		inline bool all_air () { return this->air_count == 4096; }
 		inline bool has_add () { return this->add_count > 0; }
+		inline bool has_physics () { return this->phys_count > 0; }
+		
+		static inline bool
+		is_physics_id (unsigned short id)
+			{ return physics_ids[id & 0xFFF]; }
+		
+		/* 
+		 * Flags the specified ID as having physics. Must be called before any
+		 * chunks are loaded, otherwise the physics block count of subchunks that
+		 * already contain the ID would be off.
+		 */
+		static inline void
+		register_physics_id (unsigned short id)
+			{ physics_ids[id & 0xFFF] = true; }
 		
 	//----
 		
@@ -112,6 +147,54 @@ namespace hCraft {
 		void set_id_and_meta (int x, int y, int z, unsigned short id, unsigned char meta);
 		
 		block_data get_block (int x, int y, int z);
+		
+		/* 
+		 * Sets all 4096 blocks in the subchunk to the given ID and metadata.
+		 * Light values are left untouched.
+		 */
+		void fill (unsigned short id, unsigned char meta);
+	};
+	
+	
+	/* 
+	 * A run of consecutive blocks along the X axis, all within the same row of a
+	 * single subchunk (and so contiguous in memory). Handed out by the world's
+	 * region iteration methods.
+	 */
+	struct block_run
+	{
+		int x, y, z; // world coordinates of the first block
+		int len;
+		
+		subchunk *sub;      // null if the subchunk doesn't exist (all air)
+		unsigned int index; // index of the first block in the subchunk
+		
+	//----
+		
+		// the lower 8 bits of block IDs, or null.
+		inline const unsigned char* ids () const
+			{ return this->sub ? (this->sub->ids + this->index) : nullptr; }
+		
+		inline unsigned short
+		id (int i) const
+		{
+			if (!this->sub) return 0;
+			unsigned int j = this->index + i;
+			unsigned short id = this->sub->ids[j];
+			if (this->sub->add_count > 0)
+				id |= ((j & 1) ? (this->sub->add[j >> 1] >> 4)
+											 : (this->sub->add[j >> 1] & 0xF)) << 8;
+			return id;
+		}
+		
+		inline unsigned char
+		meta (int i) const
+		{
+			if (!this->sub) return 0;
+			unsigned int j = this->index + i;
+			return (j & 1) ? (this->sub->meta[j >> 1] >> 4)
+										 : (this->sub->meta[j >> 1] & 0xF);
+		}
 	};
 	
 	
@@ -133,8 +216,29 @@ namespace hCraft {
 		int top_nonempty_subchunk ();
 		
 	public:
+		// set when the chunk holds changes that have yet to be saved to disk.
+		// NOTE: freshly generated chunks are not considered modified, since they
+		//       can always be reproduced from the world generator's seed.
 		bool modified;
-		bool generated;
+		
+		// set when the chunk's light values change. light is derived from blocks,
+		// so this alone doesn't make the chunk worth saving, unless it is
+		// @{stored}: a copy of it already exists on disk, and would otherwise be
+		// left with stale light.
+		bool relit;
+		bool stored;
+		
+		// the chunk's current lifecycle stage, and the number of neighbouring
+		// chunks (out of eight) that have reached CS_DECORATED (chunks outside
+		// of the world's boundaries are counted as decorated).
+		// NOTE: both are maintained by the world, under its chunk lock.
+		chunk_status status;
+		int decorated_neighbours;
+		
+		// set if generating this chunk has placed blocks in neighbouring chunks
+		// (e.g. trees near an edge). such chunks cannot be regenerated on their
+		// own without clobbering their neighbours, and so must be saved.
+		bool spilled;
 		
 		chunk *north; // -z
 		chunk *south; // +z
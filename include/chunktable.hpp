@@ -0,0 +1,96 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__CHUNKTABLE_H_
+#define _hCraft__CHUNKTABLE_H_
+
+#include <atomic>
+#include <vector>
+
+
+namespace hCraft {
+	
+	class chunk;
+	
+	
+	/* 
+	 * An open-addressed hash table that maps chunk coordinates to chunks.
+	 * 
+	 * Lookups are lock-free and may run concurrently with insertions and
+	 * removals, but insertions and removals must be serialized by the caller.
+	 * When the table grows, the old slot array is kept alive (until the table
+	 * is destroyed) since readers might still be probing it. The same goes for
+	 * removed chunks: the table never deletes chunks.
+	 */
+	class chunk_table
+	{
+		struct slot
+		{
+			std::atomic<unsigned long long> key;
+			std::atomic<chunk *> ch; // null if the slot was never used
+		};
+		
+		struct slot_array
+		{
+			unsigned int mask;
+			slot *slots;
+			
+			slot_array (unsigned int capacity);
+			~slot_array ();
+		};
+		
+		std::atomic<slot_array *> curr;
+		std::vector<slot_array *> retired;
+		unsigned int used; // including removed entries
+		unsigned int count;
+		
+	private:
+		void grow ();
+		void insert_into (slot_array *arr, unsigned long long key, chunk *ch);
+		
+	public:
+		inline unsigned int size () const { return this->count; }
+		
+	public:
+		chunk_table (unsigned int capacity = 1024);
+		chunk_table (const chunk_table&) = delete;
+		~chunk_table ();
+		
+		
+		/* 
+		 * Returns the chunk stored under the given key, or null if there is
+		 * none. Lock-free.
+		 */
+		chunk* find (unsigned long long key) const;
+		
+		/* 
+		 * Inserts\replaces the chunk stored under the specified key.
+		 */
+		void insert (unsigned long long key, chunk *ch);
+		
+		/* 
+		 * Removes the chunk stored under the specified key (if any).
+		 */
+		void remove (unsigned long long key);
+		
+		void clear ();
+	};
+}
+
+#endif
+
@@ -78,6 +78,64 @@ namespace hCraft {
 		//----
 			void execute (player *pl, command_reader& reader);
 		};
+		
+		
+		
+		/* 
+		 * /status -
+		 * 
+		 * Displays load statistics gathered by the server, either all of them or
+		 * only those of the specified section.
+		 * 
+		 * Permissions:
+		 *   - command.info.status
+		 *       Needed to execute the command.
+		 */
+		class c_status: public command
+		{
+		public:
+			const char* get_name () { return "status"; }
+			
+			const char*
+			get_summary ()
+				{ return "Displays load statistics gathered by the server."; }
+			
+			const char*
+			get_help ()
+			{ return 
+				".TH STATUS 1 \"/status\" \"Revision 1\" \"PLAYER COMMANDS\" "
+				".SH NAME "
+				"status - Displays load statistics gathered by the server. "
+				".SH SYNOPSIS "
+				"$g/status $ySECTION .LN "
+				"$g/status .LN "
+				"$g/status $yOPTION "
+				".PP "
+				".SH DESCRIPTION "
+				"The first form displays the statistics of section SECTION only, and the "
+				"second displays all of them. Statistics that belong to a world are "
+				"taken from the world the player is in. Available sections: "
+				".PP "
+				"$Gticks $gTick count, skipped ticks, and time spent in each tick phase "
+				".PP "
+				"$Glighting $gLighting queue, and whether lighting is overloaded "
+				".PP "
+				"$Glogins $gTime recent logins spent in each stage of the login pipeline "
+				".PP "
+				"$Gsql $gDatabase writes waiting to be flushed, and how long flushes take "
+				".PP "
+				"With OPTION, do as following: "
+				".PP "
+				"$G\\\\help \\h $gDisplays help "
+				".PP "
+				"$G\\\\summary \\s $gDisplays a short description "
+				;}
+			
+			const char* get_exec_permission () { return "command.info.status"; }
+			
+		//----
+			void execute (player *pl, command_reader& reader);
+		};
 	}
 }
 
@@ -25,12 +25,16 @@
 #include <unordered_set>
 #include <bitset>
 #include <vector>
+#include <string>
+#include <mutex>
 
 
 namespace hCraft {
 	
 	class world; // forward dec
 	class player;
+	class chunk;
+	struct subchunk;
 	
 	
 	/* 
@@ -56,6 +60,8 @@ namespace hCraft {
 			: w (w)
 			{ }
 		
+		virtual ~edit_stage () { }
+		
 		
 		// @{w} can be null
 		virtual void set_world (world *w, bool reset = true);
@@ -69,6 +75,13 @@ namespace hCraft {
 		virtual blocki get (int x, int y, int z) = 0;
 		virtual void reset (int x, int y, int z) = 0;
 		
+		/* 
+		 * Sets all blocks in the box bounded between @{min} and @{max}
+		 * (inclusive) to the specified block.
+		 */
+		virtual void fill (block_pos min, block_pos max, unsigned short id,
+			unsigned char meta = 0);
+		
 		
 		/* 
 		 * Sends all modified blocks to the specified player(s).
@@ -121,10 +134,21 @@ namespace hCraft {
 	struct des_subchunk
 	{
 		des_microchunk *micro[8];
+		
+		// if set, all 4096 blocks are set to @{fill_val} (in the same format as
+		// microchunk data), and no microchunks are allocated.
+		bool filled;
+		unsigned short fill_val;
 	
 	//----
 		des_subchunk ();
 		~des_subchunk ();
+		
+		// turns a filled subchunk back into microchunks.
+		void expand ();
+		
+		// the number of blocks set.
+		int count ();
 	};
 	
 	// 16x256x16 (16 subchunks)
@@ -155,6 +179,17 @@ namespace hCraft {
 		void send_to_players (std::vector<player *>& players,
 			int cx, int cz, des_chunk& ch, bool restore, bool update_sbs);
 		
+		void commit_filled (int cx, int sy, int cz, chunk *wch, des_subchunk *sub,
+			std::vector<unsigned short> *phys);
+		
+		blocki neighbour_block (chunk *wch, int cx, int cz, int x, int y, int z);
+		void activate_physics (int cx, int cz, chunk *wch,
+			const std::vector<unsigned short>& phys);
+		
+		int commit_chunk (int cx, int cz, des_chunk& ch,
+			std::vector<player *>& players, bool physics,
+			block_pos& bound_min, block_pos& bound_max);
+		
 	public:
 		dense_edit_stage (world *w = nullptr);
 		
@@ -166,12 +201,59 @@ namespace hCraft {
 		virtual blocki get (int x, int y, int z) override;
 		virtual void reset (int x, int y, int z) override;
 		
+		/* 
+		 * Stores the block staged at the given coordinates in @{out}.
+		 * Returns false if the block has not been modified.
+		 */
+		bool lookup (int x, int y, int z, blocki& out);
+		
+		/* 
+		 * Checks whether any blocks are staged in the specified chunk.
+		 */
+		bool has_chunk (int cx, int cz);
+		
+		/* 
+		 * Writes the blocks staged in the specified subchunk over the ones in
+		 * @{sub}. Returns false if nothing is staged there.
+		 */
+		bool overlay (int cx, int sy, int cz, subchunk *sub);
+		
+		/* 
+		 * Returns the number of blocks modified by this edit stage.
+		 */
+		int size ();
+		
+		/* 
+		 * Sets all blocks in the box bounded between @{min} and @{max}
+		 * (inclusive) to the specified block. Subchunks that are fully covered
+		 * by the box are filled as a whole, and are later committed to the world
+		 * in bulk.
+		 */
+		virtual void fill (block_pos min, block_pos max, unsigned short id,
+			unsigned char meta = 0) override;
+		
+		/* 
+		 * Discards all modifications made to the specified subchunk.
+		 */
+		void reset_subchunk (int cx, int sy, int cz);
+		
+		/* 
+		 * Discards modifications made to blocks that are also modified by
+		 * @{other}.
+		 */
+		void subtract (dense_edit_stage& other);
+		
 		
 		/* 
 		 * Sends all modified blocks to the specified player(s).
 		 */
 		virtual void preview (std::vector<player *>& players, bool update_sbs = true) override;
 		
+		/* 
+		 * Sends all modified blocks to the players that can see them.
+		 */
+		void preview_to_viewers (bool update_sbs = true);
+		
 		/* 
 		 * Same as preview (), but only sends a single chunk.
 		 */
@@ -189,6 +271,40 @@ namespace hCraft {
 		 */
 		virtual void commit (bool physics = true) override;
 		
+		/* 
+		 * Hands all staged modifications over to the world, which then commits
+		 * them gradually over the next few ticks, reporting progress to
+		 * @{initiator} (if not null). @{done_msg}, if not empty, is sent to the
+		 * initiator once the last slice has been committed. The edit stage is
+		 * left empty.
+		 */
+		void commit_sliced (player *initiator, bool physics = true,
+			const std::string& done_msg = std::string ());
+		
+		/* 
+		 * Commits a single staged chunk to the world and removes it from the
+		 * stage, holding locks only while the chunk is being written. The
+		 * changes are sent to the chunk's viewers.
+		 * @{erase_lock}, if not null, is held while the chunk is removed.
+		 * Returns the number of blocks written, or -1 if the stage is empty.
+		 */
+		int commit_next (bool physics, block_pos& bound_min, block_pos& bound_max,
+			std::mutex *erase_lock);
+		
+		/* 
+		 * Same as commit_next (), but commits the specified chunk.
+		 * Returns -1 if nothing is staged in it.
+		 */
+		int commit_at (int cx, int cz, bool physics, block_pos& bound_min,
+			block_pos& bound_max, std::mutex *erase_lock);
+		
+		/* 
+		 * Redraws selections that overlap the specified bounding box, and
+		 * flushes scoreboard changes, for all given players.
+		 */
+		static void refresh_players (std::vector<player *>& players,
+			block_pos bound_min, block_pos bound_max);
+		
 		
 		/* 
 		 * Clears the edit stage.
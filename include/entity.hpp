@@ -153,6 +153,49 @@ namespace hCraft {
 	};
 	
 	
+	/* 
+	 * The position of an entity as last broadcast to the players that can see
+	 * it. Movement is sent once per tick, as a delta from that state, using
+	 * the smallest packet that can describe it.
+	 */
+	struct entity_tracker
+	{
+		int x, y, z;        // fixed-point (1/32 of a block)
+		float r, l;
+		unsigned char br, bl; // encoded angles
+		int updates;        // since the last teleport
+		bool valid;         // false if nothing was broadcast yet
+		
+		// the update produced by the last call to update ().
+		unsigned char out[32];
+		int out_len;
+		
+	//----
+		entity_tracker ();
+		
+		/* 
+		 * Makes the next update a teleport.
+		 */
+		inline void reset () { this->valid = false; }
+		
+		/* 
+		 * Compares @{pos} with the last broadcast state, and encodes the packets
+		 * needed to bring viewers up to date into @{out}. Returns the number
+		 * of bytes encoded (zero if nothing changed).
+		 */
+		int update (int eid, const entity_pos& pos);
+		
+		/* 
+		 * Encodes the last broadcast state as absolute packets (a teleport and a
+		 * head look) into @{out}, which must be able to hold 32 bytes. Used to
+		 * resynchronize viewers that missed updates. Returns the number of bytes
+		 * encoded (zero if nothing was broadcast yet).
+		 */
+		int encode_state (int eid, unsigned char *out) const;
+	};
+	
+	
+	
 	/* 
 	 * An entity can be any movable dynamic object in a world that encompasses
 	 * a certain "state" (e.g.: players, mobs, minecarts, etc...).
@@ -170,6 +213,7 @@ namespace hCraft {
 	
 	public:
 		entity_pos pos;
+		entity_tracker tracker;
 		std::chrono::steady_clock::time_point spawn_time;
 		
 		// in terms of blocks per second
@@ -0,0 +1,100 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__ENTITYGRID_H_
+#define _hCraft__ENTITYGRID_H_
+
+#include "position.hpp"
+#include <unordered_map>
+#include <vector>
+#include <mutex>
+#include <functional>
+
+
+namespace hCraft {
+	
+	class entity;
+	
+	
+	/* 
+	 * A spatial hash of the entities in a world, used to find entities that are
+	 * close to a point without going through all of them.
+	 * 
+	 * Space is split into cubic cells of (1 << @{cell_shift}) blocks, and every
+	 * entity is kept in the cell its position falls in. Entities must be moved
+	 * between cells (with move ()) whenever their position changes.
+	 */
+	class entity_grid
+	{
+		std::unordered_map<unsigned long long, std::vector<entity *> > cells;
+		std::unordered_map<entity *, unsigned long long> where;
+		int shift;
+		std::mutex lock;
+		
+	private:
+		unsigned long long cell_of (const entity_pos& pos);
+		void remove_from_cell (entity *e, unsigned long long key);
+		
+	public:
+		inline int cell_size () const { return 1 << this->shift; }
+		
+	public:
+		entity_grid (int cell_shift = 3);
+		entity_grid (const entity_grid&) = delete;
+		
+		
+		/* 
+		 * Inserts the specified entity into the cell that contains its current
+		 * position.
+		 */
+		void insert (entity *e);
+		
+		/* 
+		 * Removes the specified entity from the grid.
+		 */
+		void remove (entity *e);
+		
+		/* 
+		 * Should be called after an entity's position changes. Moves the entity
+		 * to another cell if it has to.
+		 */
+		void move (entity *e);
+		
+		
+		/* 
+		 * Stores all entities that are within @{radius} blocks of @{center}, and
+		 * satisfy @{pred} (if given), in @{out}. The predicate is called while
+		 * the grid is locked.
+		 */
+		void query_radius (const entity_pos& center, double radius,
+			std::vector<entity *>& out,
+			std::function<bool (entity *)> pred = nullptr);
+		
+		/* 
+		 * Stores the (no more than) @{k} entities closest to @{center}, within
+		 * @{radius} blocks and satisfying @{pred} (if given), in @{out}, closest
+		 * first.
+		 */
+		void nearest (const entity_pos& center, int k, double radius,
+			std::vector<entity *>& out,
+			std::function<bool (entity *)> pred = nullptr);
+	};
+}
+
+#endif
+
@@ -59,10 +59,6 @@ namespace hCraft {
 		noise::module::Voronoi vo2;
 		*/
 		
-	private:
-		void terrain (world& wr, chunk *out, int cx, int cz);
-		void decorate (world& wr, chunk *out, int cx, int cz);
-		
 	public:
 		/* 
 		 * Constructs a new overhang world generator.
@@ -81,9 +77,14 @@ namespace hCraft {
 		
 		 
 		/* 
-		 * Generates on the specified chunk.
+		 * Generates terrain on the specified chunk.
 		 */
 		virtual void generate (world& wr, chunk *out, int cx, int cz);
+		
+		/* 
+		 * Places grass, plants and trees on top of generated terrain.
+		 */
+		virtual void decorate (world& wr, chunk *out, int cx, int cz);
 	};
 }
 
@@ -33,7 +33,15 @@ namespace hCraft {
 	{
 	public:
 		virtual ~world_generator () { }
+		
+		/* 
+		 * Generation is done in two stages: generate () lays down the base
+		 * terrain of a chunk, and decorate () is then called to place smaller
+		 * details on top of it (some of which may spill over to neighbouring
+		 * chunks).
+		 */
 		virtual void generate (world& wr, chunk *out, int cx, int cz) = 0;
+		virtual void decorate (world& wr, chunk *out, int cx, int cz) { }
 		virtual void generate_edge (world& wr, chunk *out);
 		
 		
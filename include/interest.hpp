@@ -0,0 +1,91 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__INTEREST_H_
+#define _hCraft__INTEREST_H_
+
+#include "position.hpp"
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <mutex>
+
+
+namespace hCraft {
+	
+	class player;
+	
+	
+	/* 
+	 * Keeps track of the players that can see each chunk, so that whatever
+	 * happens in a chunk can be sent to its viewers without going through every
+	 * player in the world.
+	 * 
+	 * A player views exactly the chunks it has been sent: chunk streaming
+	 * registers it with each chunk right before the chunk is sent, and
+	 * unregisters it when the chunk is unloaded. Chunks that are within the
+	 * player's view distance but were held back (e.g. because its connection
+	 * is backed up) are not viewed.
+	 */
+	class interest_index
+	{
+		std::unordered_map<unsigned long long, std::vector<player *> > viewers;
+		std::unordered_map<player *, std::unordered_set<unsigned long long> > views;
+		std::mutex lock;
+		
+	private:
+		void remove_nolock (player *pl, unsigned long long key);
+		
+	public:
+		interest_index () { }
+		interest_index (const interest_index&) = delete;
+		
+		
+		/* 
+		 * Registers\unregisters the specified player as a viewer of the given
+		 * chunk.
+		 */
+		void add (player *pl, int cx, int cz);
+		void remove (player *pl, int cx, int cz);
+		
+		/* 
+		 * Removes the specified player from the index.
+		 */
+		void remove (player *pl);
+		
+		/* 
+		 * Checks whether the specified player is viewing the given chunk.
+		 */
+		bool is_viewer (player *pl, int cx, int cz);
+		
+		
+		/* 
+		 * Stores the players that can see the given chunk in @{out} (which is
+		 * cleared first).
+		 */
+		void get_viewers (int cx, int cz, std::vector<player *>& out);
+		
+		/* 
+		 * Checks whether anybody can see the given chunk.
+		 */
+		bool has_viewers (int cx, int cz);
+	};
+}
+
+#endif
+
@@ -0,0 +1,77 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__ITEMSYS_H_
+#define _hCraft__ITEMSYS_H_
+
+#include <vector>
+
+
+namespace hCraft {
+	
+	class world;
+	class entity;
+	class pickup_item;
+	
+	
+	/* 
+	 * Ticks all the dropped items in a world as a batch.
+	 * 
+	 * The state that is touched every tick (position, age and flags) is kept
+	 * in contiguous arrays, indexed the same way as the item list, so that the
+	 * common case (an item lying on the ground) never has to go through the
+	 * item object itself. The objects are only touched when an item actually
+	 * moves, merges or gets picked up.
+	 */
+	class item_system
+	{
+		enum
+			{
+				IF_RESTING = 1, // nothing below the item last time it was checked
+				IF_MOVED   = 2, // position must be copied back to the object
+			};
+		
+		std::vector<pickup_item *> items;
+		std::vector<double> xs, ys, zs;
+		std::vector<unsigned int> ages; // in ticks
+		std::vector<unsigned char> flags;
+		
+	private:
+		void fall (world &w, unsigned long long ticks);
+		void sync (world &w);
+		
+	public:
+		inline int size () const { return (int)this->items.size (); }
+		
+	public:
+		item_system () { }
+		item_system (const item_system&) = delete;
+		
+		void add (pickup_item *item);
+		void remove (pickup_item *item);
+		
+		/* 
+		 * Ticks all items, in phases (gravity, merging, pickups), and appends
+		 * the ones that should be despawned to @{expired}.
+		 */
+		void tick (world &w, unsigned long long ticks, std::vector<entity *>& expired);
+	};
+}
+
+#endif
+
@@ -19,9 +19,15 @@
 #ifndef _hCraft__LIGHTING_H_
 #define _hCraft__LIGHTING_H_
 
+#include "threadpool.hpp"
 #include <queue>
+#include <deque>
+#include <vector>
 #include <mutex>
 #include <bitset>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
 
 
 namespace hCraft {
@@ -50,40 +56,230 @@ namespace hCraft {
 	};
 	
 	
+	/* 
+	 * A queue of lighting updates pending in a single chunk.
+	 * Positions are stored relative to the chunk, packed as (y << 8) | (z << 4) | x,
+	 * and each one is queued at most once, which is tracked by per-subchunk
+	 * bitmaps (allocated only for subchunks that have queued updates).
+	 */
+	struct light_queue
+	{
+		std::deque<unsigned short> items;
+		std::bitset<4096> *dirty[16];
+		
+	//----
+		light_queue ();
+		~light_queue ();
+		
+		inline bool empty () const { return this->items.empty (); }
+		inline int size () const { return (int)this->items.size (); }
+		
+		// returns false if the position is already queued.
+		bool push (unsigned short index);
+		unsigned short pop ();
+		void clear ();
+	};
+	
+	/* 
+	 * Sky and block light updates pending in a chunk.
+	 */
+	struct light_chunk
+	{
+		int cx, cz;
+		light_queue sl, bl;
+		
+		light_chunk (int cx, int cz)
+			: cx (cx), cz (cz)
+			{ }
+	};
+	
+	/* 
+	 * The work done on a single chunk during a call to update().
+	 * A job only ever modifies its own chunk; updates that propagate into
+	 * neighbouring chunks are collected in @{sl_out} and @{bl_out} (in world
+	 * coordinates), and are queued only after the job is done.
+	 */
+	struct light_job
+	{
+		light_chunk *lc;
+		chunk *ch;
+		int budget;
+		int sl_done, bl_done;
+		int sl_added, bl_added;
+		std::vector<light_update> sl_out, bl_out;
+		
+		light_job (light_chunk *lc, chunk *ch)
+			: lc (lc), ch (ch)
+		{
+			this->budget = 0;
+			this->sl_done = this->bl_done = 0;
+			this->sl_added = this->bl_added = 0;
+		}
+	};
+	
+	
+	/* 
+	 * A snapshot of a lighting manager's load and overload statistics.
+	 */
+	struct lighting_stats
+	{
+		bool degraded;
+		int pending;       // queued updates
+		int dirty_chunks;  // chunks waiting to be relit in degraded mode
+		int region_chunks; // chunks with subchunks marked for region relighting
+		unsigned int overloads; // times degraded mode was entered
+		unsigned long long chunks_relit; // in degraded mode
+	};
+	
+	
 	/* 
 	 * Handles block\sky lighting for a world or a chunk.
+	 * 
+	 * Updates are grouped by the chunk they fall in, and are propagated by a
+	 * breadth-first flood fill that operates directly on the chunk's subchunks,
+	 * crossing chunk boundaries through neighbour links.
+	 * 
+	 * Chunks are processed in four passes, by the parity of their coordinates
+	 * (a checkerboard in both axes). A chunk only reads from its immediate
+	 * neighbours, so chunks processed during the same pass never touch each
+	 * other's data, and are spread across the manager's thread pool.
+	 * 
+	 * Bulk edits can mark whole subchunks instead of queueing each modified
+	 * block. Marked subchunks are relit as a region: their light values are
+	 * reset from the heightmap and light sources, and updates are only queued
+	 * where light can enter or leave the region, so the cost depends on the
+	 * region's volume and surface rather than on the number of edits.
+	 * 
+	 * If the amount of queued updates ever reaches the manager's limit, the
+	 * manager switches to a degraded mode: all queued updates are collapsed into
+	 * the set of chunks they belong to, and those chunks are relit as a whole,
+	 * a few at a time. Normal operation resumes once all of them are relit.
 	 */
 	class lighting_manager
 	{
 		logger &log;
 		world *wr;
-		std::queue<light_update> sl_updates;
-		std::queue<light_update> bl_updates;
+		std::unordered_map<unsigned long long, light_chunk *> chunks;
+		std::deque<light_chunk *> active;
+		int sl_pending, bl_pending;
 		std::mutex lock;
 		
-		bool sl_overloaded, bl_overloaded;
 		int limit;
 		
+		// degraded mode
+		bool degraded;
+		std::unordered_set<unsigned long long> dirty_set;
+		std::deque<std::pair<int, int>> dirty;
+		unsigned int overload_count;
+		unsigned long long relit_count;
+		
+		// subchunks marked for region relighting (chunk key -> subchunk mask).
+		std::unordered_map<unsigned long long, unsigned short> regions;
+		std::deque<std::pair<int, int>> region_order;
+		
+		thread_pool *pool; // shared with other managers, or null
+		
+	private:
+		light_chunk* get_light_chunk (int cx, int cz);
+		void adjust_pending (int sl, int bl);
+		
+		void mark_dirty (int cx, int cz);
+		
+		/* 
+		 * Moves all queued updates into the dirty chunk set.
+		 */
+		void collapse_queues ();
+		
+		/* 
+		 * Relights no more than @{max_chunks} dirty chunks.
+		 * Returns the number of chunks relit.
+		 */
+		int relight_dirty (int max_chunks);
+		
+		/* 
+		 * Recomputes block light in the specified chunk from scratch.
+		 */
+		void relight_block_light (chunk *ch, int cx, int cz);
+		
+		/* 
+		 * Relights marked subchunks, about @{max_cost} blocks' worth (at least
+		 * one chunk's worth). Returns the number of subchunks relit.
+		 */
+		int relight_regions (int max_cost);
+		
+		/* 
+		 * Resets the light values of a single marked subchunk, and queues the
+		 * updates needed to settle them. @{batch} holds the subchunk masks of
+		 * all chunks relit along with it.
+		 */
+		void relight_subchunk (chunk *ch, int cx, int sy, int cz,
+			const std::unordered_map<unsigned long long, unsigned short>& batch);
+		
+		// enqueue updates at coordinates relative to the job's chunk (might lie
+		// outside of it).
+		void enqueue_sl_local (light_job& job, int x, int y, int z);
+		void enqueue_bl_local (light_job& job, int x, int y, int z);
+		
+		void update_sky_light (light_job& job, unsigned short index);
+		void update_block_light (light_job& job, unsigned short index);
+		
+		/* 
+		 * Handles the updates queued in a job's chunk, until its budget runs out.
+		 */
+		void run_job (light_job& job);
+		
+		/* 
+		 * Runs the given jobs in parallel, and waits for all of them to finish.
+		 * No two jobs may operate on adjacent chunks.
+		 */
+		void run_jobs (std::vector<light_job *>& jobs);
+		
 	public:
 		inline world* get_world () const { return this->wr; }
 		inline logger& get_logger () const { return this->log; }
 		
 		inline std::mutex& get_lock () { return this->lock; }
 		
+		// the number of updates currently queued (not thread-safe).
+		inline int pending () const { return this->sl_pending + this->bl_pending; }
+		inline int pending_sl () const { return this->sl_pending; }
+		inline int pending_bl () const { return this->bl_pending; }
+		
+
 	public:
 		/* 
 		 * Constructs a new lighting manager on top of the given world.
 		 */
 		lighting_manager (logger &log, world *wr, int limit = 3495254);
 		
+		/* 
+		 * Class destructor.
+		 */
+		~lighting_manager ();
+		
+		
+		/* 
+		 * Sets the thread pool used in addition to the calling thread when
+		 * handling updates (null means everything is done on the calling
+		 * thread). The pool can be shared between several managers.
+		 */
+		void set_pool (thread_pool *pool);
+		
+		/* 
+		 * Returns a consistent snapshot of the manager's statistics.
+		 */
+		lighting_stats get_stats ();
+		
 		
 		/* 
 		 * Goes through all queued updates and handles them (No more than
 		 * @{max_updates} updates are handled).
 		 * 
-		 * Returns the total amount of updates handled.
+		 * Returns the total amount of updates handled. If @{pending} is non-null,
+		 * the number of updates still queued is stored in it (or, in degraded
+		 * mode, the number of chunks still waiting to be relit).
 		 */
-		int update (int max_updates = 384);
+		int update (int max_updates = 384, int *pending = nullptr);
 		
 		/* 
 		 * Relights a whole chunk (as much as possible).
@@ -98,6 +294,14 @@ namespace hCraft {
 		
 		// not thread-safe
 		void enqueue_nolock (int x, int y, int z);
+		
+		/* 
+		 * Marks the specified subchunk to be relit as part of a region, instead
+		 * of having updates queued for each of its modified blocks.
+		 * Not thread-safe.
+		 */
+		void mark_subchunk_nolock (int cx, int sy, int cz);
+		
 		void enqueue_sl_nolock (int x, int y, int z);
 		void enqueue_bl_nolock (int x, int y, int z);
 	};
@@ -19,6 +19,8 @@
 #ifndef _hCraft__PHYSICS_H_
 #define _hCraft__PHYSICS_H_
 
+#include "blocks.hpp"
+
 
 namespace hCraft {
 	
@@ -56,6 +58,15 @@ namespace hCraft {
 		 * Called when the block gets modified (changed\destroyed).
 		 */
 		virtual void on_modified (world &w, int x, int y, int z) { }
+		
+		/* 
+		 * Checks whether a block of this type, with the given metadata, could be
+		 * changed by its surroundings. @{nb} holds its six neighbours, in the
+		 * order: -X, +X, -Y, +Y, -Z, +Z.
+		 * Used when blocks are placed in bulk, to only activate those that might
+		 * actually do something.
+		 */
+		virtual bool is_active (unsigned char meta, const blocki nb[6]) { return true; }
 	};
 }
 
@@ -37,6 +37,7 @@ namespace hCraft {
 				void *ptr) override;
 			virtual void on_neighbour_modified (world &w, int x, int y, int z,
 				int nx, int ny, int nz) override;
+			virtual bool is_active (unsigned char meta, const blocki nb[6]) override;
 		};
 	}
 }
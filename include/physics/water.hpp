@@ -35,6 +35,9 @@ namespace hCraft {
 		
 			virtual void tick (world &w, int x, int y, int z, int extra,
 				void *ptr) override;
+			virtual void on_neighbour_modified (world &w, int x, int y, int z,
+				int nx, int ny, int nz) override;
+			virtual bool is_active (unsigned char meta, const blocki nb[6]) override;
 		};
 	}
 }
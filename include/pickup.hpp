@@ -32,6 +32,30 @@ namespace hCraft {
 	{
 		slot_item data;
 		bool valid;
+		bool merged; // absorbed into another item, waiting to be despawned
+		int sys_index; // position in the world's item_system, or -1
+		
+		friend class item_system;
+		
+	private:
+		bool can_merge_with (pickup_item *other);
+		
+		/* 
+		 * Absorbs compatible items lying close to this one, as long as the
+		 * combined stack fits.
+		 */
+		void merge_nearby (world &w);
+		
+		/* 
+		 * Gives the item to the closest player in range, if there is one.
+		 * Returns true if nothing is left of the item.
+		 */
+		bool try_pickup (world &w);
+		
+		/* 
+		 * Returns true if the item should be removed from the world.
+		 */
+		inline bool expired () const { return this->merged || !this->valid; }
 		
 	public:
 		/* 
@@ -60,15 +84,13 @@ namespace hCraft {
 		
 		
 		
-		/* 
-		 * Half a second should pass after a pickup item spawns before it could be
-		 * collected by a player. This method checks if enough time has passed.
-		 */
-		bool pickable ();
-		
 		/* 
 		 * Called by the world that's holding the entity every tick (50ms).
 		 * A return value of true will cause the world to destroy the entity.
+		 * 
+		 * NOTE: Items spawned into a world are ticked in bulk by its
+		 *       item_system instead (gravity, merging and pickups all live
+		 *       there), so this only reports whether the item should go away.
 		 */
 		virtual bool tick (world &w) override;
 	};
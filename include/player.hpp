@@ -29,6 +29,8 @@
 #include "callback.hpp"
 #include "selection/world_selection.hpp"
 #include "cistring.hpp"
+#include "viewwindow.hpp"
+#include "playercache.hpp"
 
 #include <atomic>
 #include <queue>
@@ -155,10 +157,27 @@ namespace hCraft {
 		// are executed one after the other all at once in a pooled thread.
 		std::deque<unsigned char *> exec_queue;
 		
+		// the record fetched from the database during login.
+		player_record login_rec;
+		bool login_first; // first player to ever log in
+		std::chrono::steady_clock::time_point login_stage_start;
+		
 		bool writing;
 		std::queue<packet *> out_queue;
 		std::mutex out_lock;
 		
+		// output backpressure: the total size of the packets in the queue, and
+		// whether it went over the high watermark (and hasn't yet dropped below
+		// the low one). While under pressure, chunk streaming is paused and
+		// movement updates are dropped (see send_movement_updates ()).
+		unsigned int out_bytes;
+		std::atomic_bool out_pressured;
+		std::atomic_bool stream_paused; // chunks were held back
+		bool movement_stale; // movement updates were dropped
+		packet *queued_time; // time update waiting in the queue
+		bool over_limit;
+		std::chrono::steady_clock::time_point over_limit_since;
+		
 		bool ping_waiting;
 		std::chrono::time_point<std::chrono::system_clock> last_ping;
 		int ping_id;
@@ -187,17 +206,32 @@ namespace hCraft {
 		std::unordered_set<edit_stage *> edstages;
 		sparse_edit_stage sb_updates; // selection block updates
 		
+		// scratch space for chunk streaming (reused to avoid allocations).
+		std::vector<chunk_pos> stream_load;
+		std::vector<chunk_pos> stream_drop;
+		
+		// how far the player can see (in chunks). This shrinks when the server
+		// or the player's connection can't keep up, and grows back otherwise.
+		std::atomic_int view_dist;
+		std::atomic_int view_min, view_max; // from the server config and the player's rank
+		int view_calm; // consecutive load checks without any pressure
+		
 	public:
 		std::unordered_map<cistring, world_selection *> selections;
 		world_selection *curr_sel;
 		std::unordered_set<selection_block, selection_block_hash> sel_blocks;
 		blocki sb_block;
 		
-		std::unordered_set<chunk_pos, chunk_pos_hash> known_chunks;
+		view_window known_chunks;
 		
 		inventory inv;
 		
 	private:
+		/* 
+		 * Re-runs chunk streaming on a pooled thread.
+		 */
+		void schedule_stream ();
+		
 		/* 
 		 * libevent callback functions:
 		 */
@@ -285,15 +319,23 @@ namespace hCraft {
 		 * This sends common chunks (shared by two worlds in their position) without
 		 * unloading them first.
 		 */
-		void stream_common_chunks (world *wr, entity_pos dest_pos,
-			int radius = player::chunk_radius ());
+		void stream_common_chunks (world *wr, entity_pos dest_pos);
 		
 	//----
 		
 		/* 
-		 * Loads information about the player from the server's SQL database.
+		 * Logins are handled in stages, so that packet handlers never block on
+		 * the database:
+		 *   1. fetch_record (): looks up (or registers) the player's record,
+		 *      on the server's database thread.
+		 *   2. load_data (): resolves the record into a rank, nickname, etc...
+		 *   3. finish_login (): sends the login packet and joins the main world.
+		 * The last two stages run on the server's thread pool.
 		 */
+		void begin_login ();
+		void fetch_record ();
 		void load_data ();
+		void finish_login ();
 		
 	public:
 		inline server& get_server () { return this->srv; }
@@ -322,7 +364,8 @@ namespace hCraft {
 		
 		inline world* get_world () { return this->curr_world; }
 		inline std::mutex& get_world_lock () { return this->world_lock; }
-		static constexpr int chunk_radius () { return 10; }
+		inline int view_distance () const { return this->view_dist.load (); }
+		inline bool output_pressured () const { return this->out_pressured.load (); }
 		
 		inline slot_item& held_item () { return this->inv.get (this->held_slot); }
 		inline slot_item cursor_item () { return this->cursor_slot; }
@@ -387,11 +430,11 @@ namespace hCraft {
 		 * Loads new close chunks to the player and unloads those that are too
 		 * far away.
 		 */
-		void stream_chunks (int radius = player::chunk_radius ());
+		void stream_chunks ();
 		
 		/* 
-		 * Checks whether the specified chunk is within the visible chunk range
-		 * of the player.
+		 * Checks whether the specified chunk has been sent to the player (and is
+		 * still loaded on its side), i.e. whether changes made to it are visible.
 		 */
 		bool can_see_chunk (int x, int z);
 		
@@ -431,6 +474,34 @@ namespace hCraft {
 		 */
 		virtual bool despawn_from (player *pl) override;
 		
+		/* 
+		 * Sends the movement updates produced by the trackers of all visible
+		 * players during this tick to this player, as a single batch.
+		 */
+		void send_movement_updates ();
+		
+		/* 
+		 * Recomputes the bounds of the player's view distance from the server's
+		 * configuration and the player's rank, clamping the current view
+		 * distance to them. Returns true if the view distance changed.
+		 */
+		bool refresh_view_bounds ();
+		
+		/* 
+		 * Called by the player's world about once a second. Shrinks the view
+		 * distance by a chunk if the world is @{overloaded} or the player's
+		 * output queue is backed up, and grows it back after a few calm checks.
+		 */
+		void adjust_view_distance (bool overloaded);
+		
+		/* 
+		 * Called by the player's world about once a second. Disconnects the
+		 * player if its output queue stayed over the hard limit for too long,
+		 * and resumes chunk streaming once the pressure is gone.
+		 * Returns false if the player got disconnected.
+		 */
+		bool check_output ();
+		
 		
 		
 		/* 
@@ -0,0 +1,106 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__PLAYERCACHE_H_
+#define _hCraft__PLAYERCACHE_H_
+
+#include "cistring.hpp"
+#include <unordered_map>
+#include <string>
+#include <mutex>
+
+
+namespace hCraft {
+	
+	// forward decs
+	namespace sql {
+		class connection;
+	}
+	
+	
+	/* 
+	 * The stored information about a player, as found in the `players' table.
+	 */
+	struct player_record
+	{
+		std::string name;
+		bool op;
+		std::string groups; // group string (resolved into a rank on login)
+		std::string nick;
+	};
+	
+	
+	/* 
+	 * An in-memory cache of player records, so that logging in (or looking a
+	 * player up) doesn't have to go through the database every time.
+	 * 
+	 * Records are read through the cache on demand. Code that modifies a
+	 * player's row should update the cached record as well (database writes
+	 * are deferred, so the cache may be ahead of the database for a while).
+	 */
+	class player_cache
+	{
+		std::unordered_map<cistring, player_record> records;
+		int total; // number of registered players (-1 if not known yet)
+		std::mutex lock;
+		
+	public:
+		player_cache ();
+		player_cache (const player_cache&) = delete;
+		
+		
+		/* 
+		 * Returns the total number of players registered in the database.
+		 */
+		int count (sql::connection& conn);
+		
+		/* 
+		 * Fills @{out} with the record of the player that has the given name,
+		 * querying the database if it isn't cached. Returns false if no such
+		 * player is registered.
+		 */
+		bool fetch (sql::connection& conn, const char *name, player_record& out);
+		
+		/* 
+		 * Fills @{out} with the cached record of the player that has the given
+		 * name, without going through the database. Returns false if the player
+		 * isn't cached.
+		 */
+		bool lookup (const char *name, player_record& out);
+		
+		/* 
+		 * Registers a new player in the database (and the cache).
+		 */
+		void insert (sql::connection& conn, const player_record& rec);
+		
+		/* 
+		 * Modify the cached record of the player with the given name, if it is
+		 * cached.
+		 */
+		void set_nick (const char *name, const char *nick);
+		void set_groups (const char *name, const char *groups);
+		
+		/* 
+		 * Drops all cached records.
+		 */
+		void clear ();
+	};
+}
+
+#endif
+
@@ -49,6 +49,7 @@ namespace hCraft {
 		bool can_chat;       // if players of this group can send chat messages.
 		bool can_build;      // whether players of this group can modify blocks.
 		bool can_move;       // whether the players can move.
+		int  view_dist;      // max view distance in chunks (0 = server default).
 		
 		bool all_perms; // true if this group has the '*' perm.
 		bool no_perms;  // opposite
@@ -263,6 +264,12 @@ namespace hCraft {
 		 */
 		bool has (const char *perm) const;
 		
+		/* 
+		 * Returns the largest view distance allowed by the rank's groups, or
+		 * zero if none of them sets one.
+		 */
+		int view_distance () const;
+		
 	//---
 		/* 
 		 * Comparison between rank objects:
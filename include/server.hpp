@@ -30,6 +30,8 @@
 #include "permissions.hpp"
 #include "rank.hpp"
 #include "sql.hpp"
+#include "playercache.hpp"
+#include "utils.hpp"
 
 #include <unordered_map>
 #include <vector>
@@ -56,6 +58,19 @@ namespace hCraft {
 	};
 	
 	
+	/* 
+	 * The stages a login goes through (see player::begin_login ()).
+	 */
+	enum login_stage
+	{
+		LS_LOOKUP, // fetching the player's record (on the database thread)
+		LS_RANK,   // resolving the record into a rank, nickname, etc...
+		LS_JOIN,   // sending the login packet and joining the main world
+		
+		LS_COUNT
+	};
+	
+	
 	/* 
 	 * A simple POD structure for settings needed by the server to run.
 	 */
@@ -66,6 +81,10 @@ namespace hCraft {
 		int  max_players;
 		char main_world[33];
 		
+		// bounds of per-player view distances (in chunks).
+		int  min_view_dist;
+		int  max_view_dist;
+		
 		char ip[16];
 		int  port;
 	};
@@ -129,6 +148,9 @@ namespace hCraft {
 		server_config cfg;
 		
 		sql::connection_pool spool;
+		thread_pool db_exec; // a single thread that runs database lookups
+		player_cache pcache;
+		utils::sample_window login_times[LS_COUNT]; // in microseconds
 		permission_manager perms;
 		group_manager groups;
 		
@@ -152,6 +174,7 @@ namespace hCraft {
 		
 		scheduler sched;
 		thread_pool tpool;
+		thread_pool light_pool; // shared by the lighting managers of all worlds
 		
 		std::unordered_map<cistring, world *> worlds;
 		std::mutex world_lock;
@@ -261,6 +284,11 @@ namespace hCraft {
 		 */
 		static void cleanup_players (scheduler_task& task);
 		
+		/* 
+		 * Commits writes queued up in the SQL connection pool.
+		 */
+		static void flush_sql (scheduler_task& task);
+		
 	public:
 		inline bool is_running () { return this->running; }
 		inline bool is_shutting_down () { return this->shutting_down; }
@@ -270,6 +298,7 @@ namespace hCraft {
 		inline playerlist& get_players () { return *this->players; }
 		inline scheduler& get_scheduler () { return this->sched; }
 		inline thread_pool& get_thread_pool () { return this->tpool; }
+		inline thread_pool& get_lighting_pool () { return this->light_pool; }
 		inline world* get_main_world () { return this->main_world; }
 		inline command_list& get_commands () { return *this->commands; }
 		inline permission_manager& get_perms () { return this->perms; }
@@ -278,6 +307,19 @@ namespace hCraft {
 		inline std::mutex& get_player_lock () { return this->player_lock; }
 		
 		inline sql::connection_pool& sql () { return this->spool; }
+		inline thread_pool& get_db_executor () { return this->db_exec; }
+		inline player_cache& get_player_cache () { return this->pcache; }
+		
+		/* 
+		 * Returns the @{p}th percentile of the time recent logins spent in the
+		 * given stage, in microseconds.
+		 */
+		inline unsigned int
+		login_stage_time (login_stage stage, double p)
+			{ return this->login_times[stage].percentile (p); }
+		inline void
+		record_login_stage (login_stage stage, unsigned int us)
+			{ this->login_times[stage].add (us); }
 		inline void execute_sql (const std::string& str)
 		{
 			auto& conn = this->sql ().pop ();
@@ -285,6 +327,13 @@ namespace hCraft {
 			this->sql ().push (conn);
 		}
 		
+		/* 
+		 * Executes the writes queued up in the SQL connection pool, logging
+		 * any failure (failed writes stay queued for the next flush).
+		 * Returns false if some writes could not be executed.
+		 */
+		bool flush_sql_writes ();
+		
 	public:
 		/* 
 		 * Constructs a new server.
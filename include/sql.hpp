@@ -24,6 +24,7 @@
 #include <vector>
 #include <mutex>
 #include <condition_variable>
+#include "utils.hpp"
 
 
 // forward decs:
@@ -338,8 +339,48 @@ namespace hCraft {
 		
 		
 		
+		/* 
+		 * A write (INSERT, UPDATE, etc...) that is queued to be executed later
+		 * (see connection_pool::defer ()). Parameters are stored by value, and
+		 * bound once the write is executed.
+		 */
+		class deferred_write
+		{
+			friend class connection_pool;
+			
+			struct param
+			{
+				bool is_int;
+				int ival;
+				std::string sval;
+			};
+			
+			std::string sql;
+			std::vector<param> params; // index - 1
+			int attempts; // failed flushes so far
+			
+		private:
+			param& at (int index);
+			void apply (statement& stmt) const;
+			
+		public:
+			deferred_write (const char *sql);
+			
+			/* 
+			 * Parameter binding (indices start at 1, as with statements):
+			 */
+			deferred_write& bind (int index, int val);
+			deferred_write& bind (int index, const char *val);
+		};
+		
+		
+		
 		/* 
 		 * A thread-safe pool of reusable connection objects.
+		 * 
+		 * Also holds a write-behind queue: writes passed to defer () from any
+		 * thread are executed together by flush (), in a single transaction, so
+		 * that the database is only synced to disk once per batch.
 		 */
 		class connection_pool
 		{
@@ -350,6 +391,11 @@ namespace hCraft {
 			std::mutex lock;
 			std::condition_variable cv;
 			
+			std::vector<deferred_write> writes;
+			std::mutex write_lock;
+			std::mutex flush_lock;
+			utils::sample_window flush_times; // in microseconds
+			
 		public:
 			/* 
 			 * Constructs a new connection pool, and creates @{min} connections
@@ -379,6 +425,38 @@ namespace hCraft {
 			 * Removes all connection objects from this pool.
 			 */
 			void clear ();
+			
+			
+			
+			/* 
+			 * Queues the specified write to be executed on the next flush.
+			 */
+			void defer (deferred_write&& w);
+			
+			/* 
+			 * Executes all queued writes in a single transaction, preparing each
+			 * distinct statement only once. Returns the number of writes executed.
+			 * 
+			 * If the transaction fails, the writes are retried one by one, in
+			 * order, up to the first one that fails. That write and all those
+			 * after it are put back at the front of the queue, and sql_error is
+			 * thrown. A write that keeps failing is dropped after a few flushes,
+			 * so that it doesn't hold back the rest of the queue forever.
+			 */
+			int flush ();
+			
+			/* 
+			 * Returns the number of writes waiting for the next flush.
+			 */
+			int pending_writes ();
+			
+			/* 
+			 * Returns the @{p}th percentile of the time recent flushes took, in
+			 * microseconds.
+			 */
+			inline unsigned int
+			flush_time (double p)
+				{ return this->flush_times.percentile (p); }
 		};
 	}
 }
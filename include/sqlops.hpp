@@ -28,6 +28,7 @@ namespace hCraft {
 	class server;
 	namespace sql {
 		class connection;
+		class connection_pool;
 	}
 	
 	
@@ -68,9 +69,17 @@ namespace hCraft {
 		
 		/* 
 		 * Changes the rank of the player that has the specified name.
+		 * NOTE: The write is deferred to the pool's next flush.
 		 */
-		static void modify_player_rank (sql::connection& conn, const char *name,
+		static void modify_player_rank (sql::connection_pool& pool, const char *name,
 			const char *rankstr);
+		
+		/* 
+		 * Changes the nickname of the player that has the specified name.
+		 * NOTE: The write is deferred to the pool's next flush.
+		 */
+		static void modify_player_nick (sql::connection_pool& pool, const char *name,
+			const char *nick);
 	};
 }
 
@@ -19,6 +19,8 @@
 #ifndef _hCraft__UTILS_H_
 #define _hCraft__UTILS_H_
 
+#include <vector>
+#include <mutex>
 
 namespace hCraft {
 	
@@ -108,6 +110,34 @@ namespace hCraft {
 			unsigned char *dest, int level = 9);
 		unsigned char* gz_compress (unsigned char *src, unsigned long slen,
 			long& dest_size, int level = 9);
+		
+		
+		
+		//----
+		
+		/* 
+		 * Keeps the most recent samples of some measurement (e.g. durations), and
+		 * computes percentiles over them. Thread-safe.
+		 */
+		class sample_window
+		{
+			std::vector<unsigned int> samples;
+			unsigned int capacity;
+			unsigned int next;
+			std::mutex lock;
+			
+		public:
+			sample_window (unsigned int capacity = 1024);
+			
+			void add (unsigned int val);
+			void clear ();
+			
+			/* 
+			 * Returns the value below which @{p} percent of the samples fall
+			 * (0 if there are no samples).
+			 */
+			unsigned int percentile (double p);
+		};
 	}
 }
 
@@ -0,0 +1,114 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _hCraft__VIEWWINDOW_H_
+#define _hCraft__VIEWWINDOW_H_
+
+#include "position.hpp"
+#include <vector>
+
+
+namespace hCraft {
+	
+	/* 
+	 * Keeps track of which chunks a player has been sent.
+	 * 
+	 * All known chunks lie within a square of side (2 * radius + 1) centered
+	 * on the player, so instead of a set of positions, a toroidal bitmap is
+	 * used: chunk (x, z) maps to bit (x mod size, z mod size), where size is
+	 * the smallest power of two that can hold the largest such square. Moving
+	 * (or resizing) the window is then a matter of diffing the old square
+	 * against the new one.
+	 */
+	class view_window
+	{
+		int radius;
+		int max_radius;
+		int size; // power of two
+		int shift;
+		std::vector<unsigned char> bits;
+		chunk_pos center;
+		bool centered; // false if the window has no position yet
+		
+	private:
+		inline int
+		slot_of (int x, int z) const
+			{ return ((z & (this->size - 1)) << this->shift) | (x & (this->size - 1)); }
+		
+		static inline bool
+		in_square (int x, int z, chunk_pos c, int r)
+			{ return (x >= (c.x - r)) && (x <= (c.x + r))
+					&& (z >= (c.z - r)) && (z <= (c.z + r)); }
+		
+	public:
+		inline int get_radius () const { return this->radius; }
+		inline int get_max_radius () const { return this->max_radius; }
+		inline chunk_pos get_center () const { return this->center; }
+		
+	public:
+		/* 
+		 * Constructs an empty window that can span up to @{max_radius} chunks
+		 * in every direction from its center.
+		 */
+		view_window (int max_radius);
+		
+		/* 
+		 * Checks whether the chunk at the given chunk coordinates is known.
+		 */
+		bool contains (int x, int z) const;
+		
+		/* 
+		 * Marks the given chunk as known/unknown. The chunk must be within
+		 * the window's current square.
+		 */
+		void insert (int x, int z);
+		void erase (int x, int z);
+		
+		/* 
+		 * Forgets about all chunks.
+		 */
+		void clear ();
+		
+		/* 
+		 * Centers the window at @{c} and sets its radius to @{radius} (clamped
+		 * to the maximum radius). Known chunks that fall outside of the new
+		 * square are forgotten and appended to @{dropped}, and chunks inside of
+		 * it that are not known yet are appended to @{missing}.
+		 */
+		void recenter (chunk_pos c, int radius, std::vector<chunk_pos>& dropped,
+			std::vector<chunk_pos>& missing);
+		
+		/* 
+		 * Calls @{f} on every known chunk.
+		 */
+		template<typename Fn>
+		void
+		for_each (Fn f) const
+		{
+			if (!this->centered)
+				return;
+			for (int x = this->center.x - this->radius; x <= this->center.x + this->radius; ++x)
+				for (int z = this->center.z - this->radius; z <= this->center.z + this->radius; ++z)
+					if (this->bits[this->slot_of (x, z)])
+						f (chunk_pos (x, z));
+		}
+	};
+}
+
+#endif
+
@@ -27,15 +27,22 @@
 #include "physics/physics.hpp"
 #include "block_physics.hpp"
 #include "editstage.hpp"
+#include "utils.hpp"
+#include "chunktable.hpp"
+#include "interest.hpp"
+#include "entitygrid.hpp"
+#include "itemsys.hpp"
 
 #include <unordered_set>
 #include <unordered_map>
 #include <mutex>
+#include <atomic>
 #include <deque>
 #include <memory>
 #include <thread>
 #include <chrono>
 #include <functional>
+#include <string>
 
 
 namespace hCraft {
@@ -46,6 +53,7 @@ namespace hCraft {
 	class player;
 	class playerlist;
 	class world_transaction;
+	class packet;
 	
 	
 	/* 
@@ -78,6 +86,53 @@ namespace hCraft {
 		}
 	};
 	
+	/* 
+	 * Block updates waiting to be applied by the world's thread, grouped by the
+	 * chunk they fall in. Updates to the same block are coalesced into one: the
+	 * most recent block, metadata and physics parameters win, the initiating
+	 * player is kept if the newer update has none, and physics is performed if
+	 * any of the updates requested it.
+	 */
+	class block_update_queue
+	{
+		struct chunk_updates
+		{
+			std::vector<block_update> items;
+			unsigned int head;
+			
+			// block index ((y << 8) | (z << 4) | x) -> position in @{items}
+			std::unordered_map<unsigned short, unsigned int> slots;
+		};
+		
+		std::unordered_map<unsigned long long, chunk_updates *> chunks;
+		std::deque<unsigned long long> order; // in the order chunks were touched
+		int count;
+		
+	public:
+		block_update_queue ();
+		~block_update_queue ();
+		
+		inline bool empty () const { return this->count == 0; }
+		inline int size () const { return this->count; }
+		
+		
+		void push (const block_update& u);
+		
+		/* 
+		 * Discards all queued updates for which @{pred} returns true.
+		 * Returns the number of updates removed.
+		 */
+		int erase_if (std::function<bool (const block_update&)> pred);
+		
+		/* 
+		 * Removes no more than @{max} updates and appends them to @{out}, one
+		 * chunk after another. Returns the number of updates removed.
+		 */
+		int pop (std::vector<block_update>& out, int max);
+		
+		void clear ();
+	};
+	
 	enum world_physics_state
 	{
 		PHY_ON,
@@ -85,6 +140,38 @@ namespace hCraft {
 		PHY_PAUSED,
 	};
 	
+	/* 
+	 * The phases of a world tick, timed separately.
+	 */
+	enum world_tick_phase
+	{
+		WTP_BLOCKS,
+		WTP_LIGHTING,
+		WTP_ENTITIES,
+		WTP_PLAYERS,
+		
+		WTP_COUNT
+	};
+	
+	
+	
+	/* 
+	 * An edit stage that is committed to the world a slice at a time, over
+	 * several ticks.
+	 */
+	struct pending_commit
+	{
+		std::unique_ptr<dense_edit_stage> stage;
+		bool physics;
+		std::string initiator; // name of the player to report progress to
+		std::string done_msg;  // sent to the initiator once fully committed
+		
+		int total; // in blocks
+		int done;
+		int reported; // last reported progress, in percent (-1 if none)
+		block_pos bound_min, bound_max;
+	};
+	
 	
 	
 	/* 
@@ -103,20 +190,38 @@ namespace hCraft {
 		bool th_running;
 		
 		std::deque<world_transaction *> tr_updates;
-		std::deque<block_update> updates;
+		block_update_queue updates;
 		std::vector<std::shared_ptr<physics_block> > phblocks;
 		std::mutex update_lock;
 		world_physics_state ph_state;
-		unsigned long long ticks;
+		std::atomic<unsigned long long> ticks;
+		std::atomic<unsigned long long> skipped_ticks;
+		utils::sample_window phase_times[WTP_COUNT]; // in microseconds
 		
+		// all modifications are done while holding chunk_lock, @{chunk_index}
+		// mirrors @{chunks} and can be read without it.
 		std::unordered_map<unsigned long long, chunk *> chunks;
+		chunk_table chunk_index;
+		std::vector<chunk *> replaced_chunks; // freed along with the world
+		std::atomic<unsigned int> replace_gen; // bumped whenever a chunk is added or replaced
 		std::mutex chunk_lock;
 		
-		struct { int x, z; chunk *ch; } last_chunk;
+		// callbacks waiting for chunks to reach CS_READY (protected by chunk_lock).
+		std::unordered_map<unsigned long long,
+			std::vector<std::function<void (chunk *)> > > ready_waiters;
+		
+		// edit stages waiting to be committed, oldest first.
+		std::deque<pending_commit *> commits;
+		std::mutex commit_lock;
 		
 		std::unordered_set<entity *> entities;
+		item_system items;                 // dropped items, ticked in bulk
+		std::vector<entity *> generic_ents; // everything else, ticked one by one
 		std::mutex entity_lock;
 		
+		interest_index interest; // chunk -> players that can see it
+		entity_grid egrid;       // entities (and players) by position
+		
 		int width;
 		int depth;
 		entity_pos spawn_pos;
@@ -136,6 +241,9 @@ namespace hCraft {
 	public:
 		inline const char* get_name () { return this->name; }
 		inline playerlist& get_players () { return *this->players; }
+		inline interest_index& get_interest () { return this->interest; }
+		inline lighting_manager& get_lighting () { return this->lm; }
+		inline entity_grid& get_entity_grid () { return this->egrid; }
 		
 		inline world_generator* get_generator () { return this->gen; }
 		inline world_provider* get_provider () { return this->prov; }
@@ -154,6 +262,18 @@ namespace hCraft {
 		inline world_physics_state physics_state () const { return this->ph_state; }
 		inline std::mutex& get_update_lock () { return this->update_lock; }
 		
+		// tick accounting
+		inline unsigned long long get_ticks () const { return this->ticks; }
+		inline unsigned long long get_skipped_ticks () const { return this->skipped_ticks; }
+		
+		/* 
+		 * Returns the @{p}th percentile of the time spent in the given phase
+		 * of recent ticks, in microseconds.
+		 */
+		inline unsigned int
+		phase_time (world_tick_phase phase, double p)
+			{ return this->phase_times[phase].percentile (p); }
+		
 	private:
 		/* 
 		 * The function ran by the world's thread.
@@ -162,11 +282,33 @@ namespace hCraft {
 		
 		chunk* get_chunk_nolock (int x, int z);
 		
+		/* 
+		 * Advances the specified chunk to the given lifecycle stage, updating the
+		 * readiness of its neighbours and notifying waiters of chunks that become
+		 * ready as a result.
+		 */
+		void set_chunk_status (chunk *ch, int x, int z, chunk_status status);
+		
+		// adds @{delta} to the decorated neighbour count of the chunks surrounding
+		// the chunk at the given coordinates, and promotes those that become ready.
+		typedef std::vector<std::pair<chunk *,
+			std::function<void (chunk *)> > > ready_callback_list;
+		void update_neighbours_nolock (int x, int z, int delta,
+			ready_callback_list& fire);
+		void try_ready_nolock (chunk *ch, int x, int z, ready_callback_list& fire);
+		
 		std::unordered_set<entity *>::iterator
 		despawn_entity_nolock (std::unordered_set<entity *>::iterator itr);
 		
 		void get_information (world_information& inf);
 		
+		/* 
+		 * Commits staged chunks from pending edit stages until @{budget} runs
+		 * out (at least one chunk is always written). Returns true if there is
+		 * still work left. Must be called with the update lock held.
+		 */
+		bool commit_slice (std::chrono::microseconds budget);
+		
 	public:
 		/* 
 		 * Constructs a new empty world.
@@ -202,6 +344,8 @@ namespace hCraft {
 		
 		/* 
 		 * Saves all modified chunks to disk.
+		 * Chunks that have only been generated (and not modified since) are
+		 * skipped, as they can be regenerated from the world's seed.
 		 */
 		void save_all ();
 		
@@ -233,6 +377,7 @@ namespace hCraft {
 		
 		/* 
 		 * Searches the chunk world for a chunk located at the specified coordinates.
+		 * Lock-free.
 		 */
 		chunk* get_chunk (int x, int z);
 		
@@ -243,11 +388,21 @@ namespace hCraft {
 		
 		/* 
 		 * Same as get_chunk (), but if the chunk does not exist, it will be either
-		 * loaded from a file (if such a file exists), or completely generated from
-		 * scratch.
+		 * loaded from a file (if such a file exists), or generated from scratch.
+		 * The returned chunk is guaranteed to have reached at least the lifecycle
+		 * stage specified by @{status} (requesting CS_READY causes neighbouring
+		 * chunks to be decorated as well, and requesting CS_EMPTY skips generation
+		 * altogether).
 		 */
-		chunk* load_chunk (int x, int z);
-		chunk* load_chunk_at (int bx, int bz);
+		chunk* load_chunk (int x, int z, chunk_status status = CS_LIT);
+		chunk* load_chunk_at (int bx, int bz, chunk_status status = CS_LIT);
+		
+		/* 
+		 * Calls the given function once the chunk located at the specified
+		 * coordinates becomes ready (immediately, if it already is).
+		 * NOTE: This does not cause the chunk to be loaded.
+		 */
+		void when_ready (int x, int z, std::function<void (chunk *)> f);
 		
 		/* 
 		 * Checks whether a block exists at the given coordinates.
@@ -272,6 +427,12 @@ namespace hCraft {
 		 */
 		void all_entities (std::function<void (entity *e)> f);
 		
+		/* 
+		 * Sends the specified packet to all players that can see the given
+		 * chunk, except for @{except}. The packet is destroyed afterwards.
+		 */
+		void send_to_viewers (chunk_pos cpos, packet *pack, player *except = nullptr);
+		
 		
 		
 		/* 
@@ -304,6 +465,124 @@ namespace hCraft {
 		 */
 		blocki get_final_block (int x, int y, int z);
 		
+		/* 
+		 * Takes ownership of the specified edit stage, and commits it to the
+		 * world gradually, in bounded slices over the next few ticks. Progress
+		 * is reported to @{initiator}, if not null, and @{done_msg} is sent to
+		 * it once the last slice lands.
+		 * 
+		 * Block updates queued before the call to blocks that the stage modifies
+		 * are discarded. Updates queued after it to chunks that the stage has
+		 * yet to reach have the chunk committed first.
+		 */
+		void queue_commit (dense_edit_stage *stage, bool physics,
+			player *initiator = nullptr,
+			const std::string& done_msg = std::string ());
+		
+		/* 
+		 * Immediately commits whatever pending edit stages have staged in the
+		 * specified chunk, oldest first. Must be called with the update lock
+		 * held, before the chunk is modified by a newer edit.
+		 */
+		void commit_pending_at (int cx, int cz);
+		
+		/* 
+		 * Discards queued block updates to those blocks for which @{pred}
+		 * returns true, as they are about to be overwritten by a newer edit.
+		 * Must be called with the update lock held.
+		 */
+		void drop_updates (std::function<bool (int x, int y, int z)> pred);
+		
+		/* 
+		 * Returns the number of edit stages that have yet to be fully committed.
+		 */
+		int pending_commits ();
+		
+		
+		/* 
+		 * Region access:
+		 * 
+		 * The following methods operate on the box between @{min} and @{max}
+		 * (inclusive, clipped to the world's bounds), a chunk at a time, with a
+		 * single chunk lookup per chunk. Blocks are visited in memory order
+		 * (X, then Z, then Y) within each subchunk.
+		 */
+		
+		/* 
+		 * Calls @{f} on every run of blocks in the box. Runs that lie in chunks
+		 * that aren't loaded are reported as air (their @{sub} is null). Blocks
+		 * staged by edits that are still being committed are reported as if
+		 * they had already been written.
+		 */
+		void for_each_run (block_pos min, block_pos max,
+			std::function<void (const block_run&)> f);
+		
+		/* 
+		 * Calls @{f} on every block in the box.
+		 */
+		void for_each_block (block_pos min, block_pos max,
+			std::function<void (int x, int y, int z, unsigned short id,
+				unsigned char meta)> f);
+		
+		/* 
+		 * Reads the IDs and metadata values of all blocks in the box into the
+		 * specified arrays (either of which may be null). Both are laid out as
+		 * [y][z][x], relative to @{min}, and must be large enough to hold the
+		 * entire box. Blocks outside of the world are read as air.
+		 */
+		void read_box (block_pos min, block_pos max, unsigned short *ids,
+			unsigned char *meta);
+		
+		/* 
+		 * Writes blocks from the given arrays (laid out as in read_box ()) into
+		 * the box, loading chunks as necessary. If @{meta} is null, metadata
+		 * values are set to zero. Like set_id_and_meta (), this modifies chunks
+		 * directly: players aren't notified, and nothing is relit.
+		 */
+		void write_box (block_pos min, block_pos max, const unsigned short *ids,
+			const unsigned char *meta);
+		
+		
+		/* 
+		 * A cursor over the world's chunks, to be used by a single thread at a
+		 * time. It remembers the last chunk it has accessed, and reaches chunks
+		 * adjacent to it through neighbour links, so that long sequences of
+		 * nearby reads and writes don't have to go through the chunk table.
+		 * 
+		 * Like the world's own methods, getters never load chunks, and setters
+		 * load\generate them as needed.
+		 * 
+		 * The remembered chunk is dropped as soon as any chunk in the world gets
+		 * replaced, so the cursor can be kept across ticks.
+		 */
+		class accessor
+		{
+			world &wr;
+			int cx, cz;
+			chunk *ch;
+			unsigned int gen; // value of the world's replace_gen when @{ch} was set
+			
+		public:
+			accessor (world &wr);
+			
+			inline world& get_world () { return this->wr; }
+			
+			chunk* get_chunk (int cx, int cz);
+			chunk* load_chunk (int cx, int cz);
+			
+			void set_id (int x, int y, int z, unsigned short id);
+			unsigned short get_id (int x, int y, int z);
+			
+			void set_meta (int x, int y, int z, unsigned char val);
+			unsigned char get_meta (int x, int y, int z);
+			
+			unsigned char get_block_light (int x, int y, int z);
+			unsigned char get_sky_light (int x, int y, int z);
+			
+			void set_id_and_meta (int x, int y, int z, unsigned short id, unsigned char meta);
+			block_data get_block (int x, int y, int z);
+		};
+		
 	//----
 		
 		/* 
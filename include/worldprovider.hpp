@@ -134,6 +134,9 @@ namespace hCraft {
 		 * Attempts to load the chunk located at the specified coordinates into
 		 * @{ch}. Returns true on success, and false if the chunk is not present
 		 * within the world file.
+		 * The chunk's status is set to CS_DECORATED, or to CS_EMPTY if it was
+		 * saved before being generated (holding only blocks that spilled into
+		 * it from its neighbours).
 		 */
 		virtual bool load (world &wr, chunk *ch, int x, int z) = 0;
 		
@@ -25,6 +25,10 @@
 
 namespace hCraft {
 	
+	bool subchunk::physics_ids[4096] = { false };
+	
+	
+	
 	/* 
 	 * Constructs a new empty subchunk, with all blocks set to air.
 	 */
@@ -40,6 +44,7 @@ namespace hCraft {
 		
 				this->add_count = 0;
 				this->air_count = 4096;
+				this->phys_count = 0;
 			}
 	}
 	
@@ -91,6 +96,14 @@ namespace hCraft {
 		else if (!prev_id && id)
 			-- this->air_count;
 		
+		if (prev_id != id)
+			{
+				if (is_physics_id (prev_id))
+					-- this->phys_count;
+				if (is_physics_id (id))
+					++ this->phys_count;
+			}
+		
 		if (prev_hi && !hi)
 			-- this->add_count;
 		else if (!prev_hi && hi)
@@ -226,6 +239,14 @@ namespace hCraft {
 			++ this->air_count;
 		else if (!prev_id && id)
 			-- this->air_count;
+		
+		if (prev_id != id)
+			{
+				if (is_physics_id (prev_id))
+					-- this->phys_count;
+				if (is_physics_id (id))
+					++ this->phys_count;
+			}
 
 		if (prev_hi && !hi)
 			-- this->add_count;
@@ -234,6 +255,35 @@ namespace hCraft {
 	}
 	
 	
+	/* 
+	 * Sets all 4096 blocks in the subchunk to the given ID and metadata.
+	 * Light values are left untouched.
+	 */
+	void
+	subchunk::fill (unsigned short id, unsigned char meta)
+	{
+		unsigned char hi = (id >> 8) & 0xF;
+		
+		std::memset (this->ids, id & 0xFF, 4096);
+		std::memset (this->meta, (meta & 0xF) | (meta << 4), 2048);
+		if (hi)
+			{
+				if (!this->add)
+					this->add = new unsigned char[2048];
+				std::memset (this->add, hi | (hi << 4), 2048);
+			}
+		else if (this->add)
+			{
+				delete[] this->add;
+				this->add = nullptr;
+			}
+		
+		this->air_count = id ? 0 : 4096;
+		this->add_count = hi ? 4096 : 0;
+		this->phys_count = is_physics_id (id) ? 4096 : 0;
+	}
+	
+	
 	block_data
 	subchunk::get_block (int x, int y, int z)
 	{
@@ -284,7 +334,11 @@ namespace hCraft {
 		
 		std::memset (this->biomes, BI_PLAINS, 256);
 		this->modified = true;
-		this->generated = false;
+		this->relit = false;
+		this->stored = false;
+		this->status = CS_EMPTY;
+		this->decorated_neighbours = 0;
+		this->spilled = false;
 		
 		this->north = this->south = this->east = this->west = nullptr;
 	}
@@ -393,7 +447,7 @@ namespace hCraft {
 			}
 		
 		//if (sub->get_block_light (x, y & 0xF, z) != val)
-			this->modified = true;
+			this->relit = true;
 		sub->set_block_light (x, y & 0xF, z, val);
 	}
 	
@@ -423,7 +477,7 @@ namespace hCraft {
 			}
 		
 		//if (sub->get_sky_light (x, y & 0xF, z) != val)
-			this->modified = true;
+			this->relit = true;
 		sub->set_sky_light (x, y & 0xF, z, val);
 	}
 	
@@ -606,13 +660,9 @@ namespace hCraft {
 				
 				if (!ch)
 					{
-						ch = this->wr.get_chunk (cx, cz);
-						if (!ch)
-							{
-								// place empty chunk
-								ch = new chunk ();
-								this->wr.put_chunk (cx, cz, ch);
-							}
+						// loads the chunk if it's been saved, otherwise places an empty
+						// chunk to hold the spilled blocks.
+						ch = this->wr.load_chunk (cx, cz, CS_EMPTY);
 					}
 
 				this->last.ch = ch;
@@ -630,7 +680,11 @@ namespace hCraft {
 	{
 		chunk *ch = this->follow (x >> 4, z >> 4);
 		if (ch)
-			ch->set_id_and_meta (x & 0xF, y, z & 0xF, id, meta);
+			{
+				ch->set_id_and_meta (x & 0xF, y, z & 0xF, id, meta);
+				if (ch != this->center.ch && this->center.ch)
+					this->center.ch->spilled = true;
+			}
 	}
 	 
 	unsigned short
@@ -0,0 +1,203 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "chunktable.hpp"
+
+
+namespace hCraft {
+	
+	// marks entries that have been removed (keeps probe sequences intact).
+	static chunk *const removed_chunk = reinterpret_cast<chunk *> (1);
+	
+	static inline unsigned int
+	hash_key (unsigned long long key)
+	{
+		key ^= key >> 33;
+		key *= 0xFF51AFD7ED558CCDULL;
+		key ^= key >> 33;
+		return (unsigned int)key;
+	}
+	
+	
+	
+	chunk_table::slot_array::slot_array (unsigned int capacity)
+	{
+		this->mask = capacity - 1;
+		this->slots = new slot[capacity];
+		for (unsigned int i = 0; i < capacity; ++i)
+			{
+				this->slots[i].key.store (0, std::memory_order_relaxed);
+				this->slots[i].ch.store (nullptr, std::memory_order_relaxed);
+			}
+	}
+	
+	chunk_table::slot_array::~slot_array ()
+	{
+		delete[] this->slots;
+	}
+	
+	
+	
+	chunk_table::chunk_table (unsigned int capacity)
+	{
+		// round up to a power of two.
+		unsigned int cap = 16;
+		while (cap < capacity)
+			cap <<= 1;
+		
+		this->curr.store (new slot_array (cap));
+		this->used = 0;
+		this->count = 0;
+	}
+	
+	chunk_table::~chunk_table ()
+	{
+		delete this->curr.load ();
+		for (slot_array *arr : this->retired)
+			delete arr;
+	}
+	
+	
+	
+	/* 
+	 * Returns the chunk stored under the given key, or null if there is
+	 * none. Lock-free.
+	 */
+	chunk*
+	chunk_table::find (unsigned long long key) const
+	{
+		slot_array *arr = this->curr.load (std::memory_order_acquire);
+		unsigned int i = hash_key (key) & arr->mask;
+		for (;;)
+			{
+				slot& s = arr->slots[i];
+				chunk *ch = s.ch.load (std::memory_order_acquire);
+				if (!ch)
+					return nullptr;
+				if (s.key.load (std::memory_order_relaxed) == key)
+					return (ch == removed_chunk) ? nullptr : ch;
+				
+				i = (i + 1) & arr->mask;
+			}
+	}
+	
+	
+	void
+	chunk_table::insert_into (slot_array *arr, unsigned long long key, chunk *ch)
+	{
+		unsigned int i = hash_key (key) & arr->mask;
+		for (;;)
+			{
+				slot& s = arr->slots[i];
+				chunk *prev = s.ch.load (std::memory_order_relaxed);
+				if (!prev)
+					{
+						// the key must be visible before the chunk is.
+						s.key.store (key, std::memory_order_relaxed);
+						s.ch.store (ch, std::memory_order_release);
+						++ this->used;
+						++ this->count;
+						return;
+					}
+				else if (s.key.load (std::memory_order_relaxed) == key)
+					{
+						if (prev == removed_chunk)
+							++ this->count;
+						s.ch.store (ch, std::memory_order_release);
+						return;
+					}
+				
+				i = (i + 1) & arr->mask;
+			}
+	}
+	
+	void
+	chunk_table::grow ()
+	{
+		slot_array *old = this->curr.load (std::memory_order_relaxed);
+		slot_array *arr = new slot_array ((old->mask + 1) * 2);
+		
+		this->used = 0;
+		this->count = 0;
+		for (unsigned int i = 0; i <= old->mask; ++i)
+			{
+				chunk *ch = old->slots[i].ch.load (std::memory_order_relaxed);
+				if (ch && ch != removed_chunk)
+					this->insert_into (arr, old->slots[i].key.load (std::memory_order_relaxed), ch);
+			}
+		
+		this->curr.store (arr, std::memory_order_release);
+		this->retired.push_back (old);
+	}
+	
+	/* 
+	 * Inserts\replaces the chunk stored under the specified key.
+	 */
+	void
+	chunk_table::insert (unsigned long long key, chunk *ch)
+	{
+		slot_array *arr = this->curr.load (std::memory_order_relaxed);
+		if ((this->used + 1) * 2 > (arr->mask + 1))
+			{
+				this->grow ();
+				arr = this->curr.load (std::memory_order_relaxed);
+			}
+		
+		this->insert_into (arr, key, ch);
+	}
+	
+	/* 
+	 * Removes the chunk stored under the specified key (if any).
+	 */
+	void
+	chunk_table::remove (unsigned long long key)
+	{
+		slot_array *arr = this->curr.load (std::memory_order_relaxed);
+		unsigned int i = hash_key (key) & arr->mask;
+		for (;;)
+			{
+				slot& s = arr->slots[i];
+				chunk *ch = s.ch.load (std::memory_order_relaxed);
+				if (!ch)
+					return;
+				if (s.key.load (std::memory_order_relaxed) == key)
+					{
+						if (ch != removed_chunk)
+							{
+								s.ch.store (removed_chunk, std::memory_order_release);
+								-- this->count;
+							}
+						return;
+					}
+				
+				i = (i + 1) & arr->mask;
+			}
+	}
+	
+	void
+	chunk_table::clear ()
+	{
+		// readers might still be looking at the current array.
+		slot_array *old = this->curr.load (std::memory_order_relaxed);
+		this->curr.store (new slot_array (old->mask + 1), std::memory_order_release);
+		this->retired.push_back (old);
+		this->used = 0;
+		this->count = 0;
+	}
+}
+
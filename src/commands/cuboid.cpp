@@ -45,10 +45,9 @@ namespace hCraft {
 			dense_edit_stage es (pl->get_world ());
 			draw_ops draw (es);
 			draw.fill_cuboid (marked[0], marked[1], data->bl);
-			es.commit ();
+			es.commit_sliced (pl, true, "§3Cuboid complete");
 			
 			pl->delete_data ("cuboid");
-			pl->message ("§3Cuboid complete");
 			return true;
 		}
 		
@@ -116,47 +116,44 @@ namespace hCraft {
 								sel_inner->contract (1, 1, 1);
 							}
 						
-						block_pos min_p = sel->min ();
-						block_pos max_p = sel->max ();
-						
-						if (min_p.y < 0) min_p.y = 0;
-						if (min_p.y > 255) min_p.y = 255;
-						if (max_p.y < 0) max_p.y = 0;
-						if (max_p.y > 255) max_p.y = 255;
-						for (int y = max_p.y; y >= min_p.y; --y)
-							for (int x = min_p.x; x <= max_p.x; ++x)
-								for (int z = min_p.z; z <= max_p.z; ++z)
-									{
-										if (!wr->in_bounds (x, y, z)) continue;
-										if (!sel->contains (x, y, z)) continue;
-										if (do_hollow && sel_inner->contains (x, y, z)) continue;
-										
-										block_data bd = wr->get_block (x, y, z);
-										if (bd_in.id != 0xFFFF && (bd.id != bd_in.id || bd.meta != bd_in.meta))
-											continue;
-										if (bd.id == bd_out.id && bd.meta == bd_out.meta)
-											continue;
-										
-										if (is_rand)
-											{
-												if (dis (rnd) < rprec)
-													{
-														es.set (x, y, z, bd_out.id, bd_out.meta);
-														++ block_counter;
-													}
-											}
-										else
-											{
-												es.set (x, y, z, bd_out.id, bd_out.meta);
-												++ block_counter;
-											}
-								
-										if (!sel_cont)
-											++ selection_counter;
-										sel_cont = true;
-									}
+						wr->for_each_run (sel->min (), sel->max (),
+							[&] (const block_run& run)
+								{
+									int y = run.y, z = run.z;
+									for (int i = 0; i < run.len; ++i)
+										{
+											int x = run.x + i;
+											if (!sel->contains (x, y, z)) continue;
+											if (do_hollow && sel_inner->contains (x, y, z)) continue;
+											
+											unsigned short id = run.id (i);
+											unsigned char meta = run.meta (i);
+											if (bd_in.id != 0xFFFF && (id != bd_in.id || meta != bd_in.meta))
+												continue;
+											if (id == bd_out.id && meta == bd_out.meta)
+												continue;
+											
+											if (is_rand)
+												{
+													if (dis (rnd) < rprec)
+														{
+															es.set (x, y, z, bd_out.id, bd_out.meta);
+															++ block_counter;
+														}
+												}
+											else
+												{
+													es.set (x, y, z, bd_out.id, bd_out.meta);
+													++ block_counter;
+												}
+									
+											if (!sel_cont)
+												++ selection_counter;
+											sel_cont = true;
+										}
+								});
 					
-						es.commit (do_physics);
+						es.commit_sliced (pl, do_physics);
 						if (do_hollow)
 							delete sel_inner;
 					}
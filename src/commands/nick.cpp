@@ -20,6 +20,7 @@
 #include "../player.hpp"
 #include "../server.hpp"
 #include "../rank.hpp"
+#include "../sqlops.hpp"
 #include <cstring>
 #include <sstream>
 
@@ -51,31 +52,53 @@ namespace hCraft {
 			player *target = pl->get_server ().get_players ().find (target_name.c_str ());
 			if (target)
 				target_name.assign (target->get_username ());
-			auto& conn = pl->get_server ().sql ().pop ();
-			auto stmt = conn.query (
-				"SELECT * FROM `players` WHERE `name` LIKE ?");
-			sql::row row;
 			
-			stmt.bind (1, target_name.c_str (), sql::pass_transient);
-			if (!stmt.step (row))
+			// the cache is kept up to date with deferred nick changes, the database
+			// is only consulted (after flushing them) for players that aren't cached.
+			player_record rec;
+			if (!pl->get_server ().get_player_cache ().lookup (target_name.c_str (), rec))
 				{
-					pl->message ("§c * §7Unable to find player§f: §c" + target_name);
-					return;
+					pl->get_server ().flush_sql_writes (); // see pending nick changes
+					auto& conn = pl->get_server ().sql ().pop ();
+					bool found;
+					{
+						auto stmt = conn.query (
+							"SELECT * FROM `players` WHERE `name` LIKE ?");
+						sql::row row;
+						
+						stmt.bind (1, target_name.c_str (), sql::pass_transient);
+						found = stmt.step (row);
+						if (found)
+							{
+								rec.name.assign (row.at (1).as_cstr ());
+								rec.op = (row.at (2).as_int () == 1);
+								rec.groups.assign (row.at (3).as_cstr ());
+								rec.nick.assign (row.at (4).as_cstr ());
+							}
+					}
+					pl->get_server ().sql ().push (conn);
+					
+					if (!found)
+						{
+							pl->message ("§c * §7Unable to find player§f: §c" + target_name);
+							return;
+						}
 				}
 			
-			rank rnk (row.at (3).as_cstr (), pl->get_server ().get_groups ());
-			prev_nickname.assign (row.at (4).as_cstr ());
+			target_name.assign (rec.name);
+			rank rnk (rec.groups.c_str (), pl->get_server ().get_groups ());
+			prev_nickname.assign (rec.nick);
 			if (reader.arg_count () >= 2)
 				nickname.assign (reader.all_from (1));
 			else
-				nickname.assign (row.at (1).as_cstr ());
+				nickname.assign (rec.name);
 			if (nickname.empty () || nickname.length () > 36)
 				{
 					pl->message ("§c * §7A nickname cannot have more than §c36 "
 											 "§7characters or be empty§f.");
 					return;
 				}
-			else if (std::strcmp (nickname.c_str (), row.at (4).as_cstr ()) == 0)
+			else if (nickname == prev_nickname)
 				{
 					pl->message ("§ePlayer §a" + target_name + " §ealready has that nickname§f.");
 					return;
@@ -85,19 +108,16 @@ namespace hCraft {
 				std::ostringstream ss;
 				if (target)
 					target->set_nickname (nickname.c_str (), false);
-				ss << "UPDATE `players` SET `nick`='"
-					 << nickname << "' WHERE `name`='"
-					 << target_name << "';";
-				conn.execute (ss.str ());
-						
-				ss.clear (); ss.str (std::string ());
+				sqlops::modify_player_nick (pl->get_server ().sql (),
+					target_name.c_str (), nickname.c_str ());
+				pl->get_server ().get_player_cache ().set_nick (
+					target_name.c_str (), nickname.c_str ());
+				
 				ss << "§" << rnk.main ()->color << prev_nickname
 					 << " §eis now known as§f: §" << rnk.main ()->color
 					 << nickname << "§f!";
 				pl->get_server ().get_players ().message (ss.str ());
 			}
-			
-			pl->get_server ().sql ().push (conn);
 		}
 	}
 }
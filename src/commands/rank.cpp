@@ -144,11 +144,38 @@ namespace hCraft {
 			player *target = nullptr;
 			sqlops::player_info pinf;
 			{
-				auto& conn = pl->get_server ().sql ().pop ();
-				if (!sqlops::player_data (conn, target_name.c_str (), pl->get_server (), pinf))
+				// the cache is kept up to date with deferred rank changes, the
+				// database is only consulted (after flushing them) for players that
+				// aren't cached.
+				player_record rec;
+				if (pl->get_server ().get_player_cache ().lookup (target_name.c_str (), rec))
 					{
-						pl->message ("§c * §7Unknown player§f: §c" + target_name);
-						return;
+						pinf.id = -1;
+						pinf.name = rec.name;
+						pinf.op = rec.op;
+						try
+							{
+								pinf.rnk.set (rec.groups.c_str (), pl->get_server ().get_groups ());
+							}
+						catch (const std::exception& str)
+							{
+								// invalid rank
+								pinf.rnk.set (pl->get_server ().get_groups ().default_rank);
+							}
+						pinf.nick = rec.nick;
+					}
+				else
+					{
+						pl->get_server ().flush_sql_writes (); // see pending rank changes
+						auto& conn = pl->get_server ().sql ().pop ();
+						bool found = sqlops::player_data (conn, target_name.c_str (),
+							pl->get_server (), pinf);
+						pl->get_server ().sql ().push (conn);
+						if (!found)
+							{
+								pl->message ("§c * §7Unknown player§f: §c" + target_name);
+								return;
+							}
 					}
 				
 				target_name.assign (pinf.name);
@@ -182,7 +209,10 @@ namespace hCraft {
 					{
 						std::string rank_str;
 						new_rank.get_string (rank_str);
-						sqlops::modify_player_rank (conn, target_name.c_str (), rank_str.c_str ());
+						sqlops::modify_player_rank (pl->get_server ().sql (),
+							target_name.c_str (), rank_str.c_str ());
+						pl->get_server ().get_player_cache ().set_groups (
+							target_name.c_str (), rank_str.c_str ());
 					}
 				catch (const std::exception& ex)
 					{
@@ -212,8 +242,6 @@ namespace hCraft {
 						<< " §7rank has been updated";
 					pl->message (ss.str ());
 				}
-				
-				pl->get_server ().sql ().push (conn);
 			}
 		}
 	}
@@ -424,49 +424,28 @@ namespace hCraft {
 					world_selection *sel = itr->second;
 					if (sel->visible ())
 						{
-							int x, y, z;
-							block_pos smin = sel->min (), smax = sel->max ();
-							if (smin.y < 0) smin.y = 0;
-							if (smin.y > 255) smin.y = 255;
-							if (smax.y < 0) smax.y = 0;
-							if (smax.y > 255) smax.y = 255;
-							for (y = smin.y; y <= smax.y; ++y)
-								{
-									for (x = smin.x; x <= smax.x; ++x)
-										for (z = smin.z; z <= smax.z; ++z)
+							wr->for_each_run (sel->min (), sel->max (),
+								[&] (const block_run& run)
+									{
+										for (int i = 0; i < run.len; ++i)
 											{
-												if (!wr->in_bounds (x, y, z)) continue;
-												if (sel->contains (x, y, z))
+												int x = run.x + i;
+												if (!sel->contains (x, run.y, run.z))
+													continue;
+												
+												unsigned short id = run.id (i);
+												unsigned char meta = run.meta (i);
+												bool found = false;
+												for (blocki ibd : blocks)
+													if (ibd.id == id && ibd.meta == meta)
+														{ found = true; break; }
+												if (found == (state == R_INCLUDE))
 													{
-														if (state == R_INCLUDE)
-															{
-																block_data bd = wr->get_block (x, y, z);
-																bool found = false;
-																for (blocki ibd : blocks)
-																	if (ibd.id == bd.id && ibd.meta == bd.meta)
-																		{ found = true; break; }
-																if (found)
-																	{
-																		bsel->set_block (x, y, z, true);
-																		++ counter;
-																	}
-															}
-														else
-															{
-																block_data bd = wr->get_block (x, y, z);
-																bool found = false;
-																for (blocki ibd : blocks)
-																	if (ibd.id == bd.id && ibd.meta == bd.meta)
-																		{ found = true; break; }
-																if (!found)
-																	{
-																		bsel->set_block (x, y, z, true);
-																		++ counter;
-																	}
-															}
+														bsel->set_block (x, run.y, run.z, true);
+														++ counter;
 													}
 											}
-									}
+									});
 						}
 				}
 			
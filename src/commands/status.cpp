@@ -0,0 +1,173 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "infoc.hpp"
+#include "../server.hpp"
+#include "../player.hpp"
+#include "../world.hpp"
+#include "stringutils.hpp"
+#include <sstream>
+
+
+namespace hCraft {
+	namespace commands {
+		
+		static void
+		show_lighting (player *pl)
+		{
+			world *wr = pl->get_world ();
+			lighting_stats st = wr->get_lighting ().get_stats ();
+			
+			std::ostringstream ss;
+			ss << "§eLighting §f(§a" << wr->get_name () << "§f)§e: ";
+			if (st.degraded)
+				ss << "§cdegraded§f, §c" << st.dirty_chunks << " §echunks left to relight";
+			else
+				ss << "§anormal§f, §a" << st.pending << " §eupdates queued§f, §a"
+					 << st.region_chunks << " §echunks marked for region relighting";
+			pl->message (ss.str ());
+			
+			ss.clear (); ss.str (std::string ());
+			ss << "§e  Overloads§f: §c" << st.overloads << "§f, §eChunks relit§f: §c"
+				 << st.chunks_relit;
+			pl->message (ss.str ());
+		}
+		
+		
+		
+		static void
+		show_ticks (player *pl)
+		{
+			static const char *phase_names[WTP_COUNT] = {
+				"blocks", "lighting", "entities", "players" };
+			
+			world *wr = pl->get_world ();
+			
+			std::ostringstream ss;
+			ss << "§eTicks §f(§a" << wr->get_name () << "§f)§e: §a" << wr->get_ticks ()
+				 << " §etotal§f, §c" << wr->get_skipped_ticks () << " §eskipped";
+			pl->message (ss.str ());
+			
+			// median and 95th percentile of each phase, in microseconds.
+			ss.clear (); ss.str (std::string ());
+			ss << "§e  Phases §7(p50/p95 us)§f:";
+			for (int i = 0; i < WTP_COUNT; ++i)
+				{
+					world_tick_phase ph = (world_tick_phase)i;
+					ss << " §e" << phase_names[i] << " §a" << wr->phase_time (ph, 50.0)
+						 << "§f/§c" << wr->phase_time (ph, 95.0);
+				}
+			pl->message (ss.str ());
+		}
+		
+		
+		
+		static void
+		show_logins (player *pl)
+		{
+			static const char *stage_names[LS_COUNT] = {
+				"lookup", "rank", "join" };
+			
+			server &srv = pl->get_server ();
+			
+			// median and 95th percentile of each stage, in microseconds.
+			std::ostringstream ss;
+			ss << "§eLogins §7(p50/p95 us)§f:";
+			for (int i = 0; i < LS_COUNT; ++i)
+				{
+					login_stage st = (login_stage)i;
+					ss << " §e" << stage_names[i] << " §a" << srv.login_stage_time (st, 50.0)
+						 << "§f/§c" << srv.login_stage_time (st, 95.0);
+				}
+			pl->message (ss.str ());
+		}
+		
+		
+		
+		static void
+		show_sql (player *pl)
+		{
+			sql::connection_pool& pool = pl->get_server ().sql ();
+			
+			std::ostringstream ss;
+			ss << "§eSQL§f: §a" << pool.pending_writes () << " §ewrites queued§f, "
+				 << "§eflushes §7(p50/p95 us)§f: §a" << pool.flush_time (50.0)
+				 << "§f/§c" << pool.flush_time (95.0);
+			pl->message (ss.str ());
+		}
+		
+		
+		
+		struct status_section
+		{
+			const char *name;
+			void (*show) (player *);
+		};
+		
+		static const status_section sections[] = {
+				{ "ticks", show_ticks },
+				{ "lighting", show_lighting },
+				{ "logins", show_logins },
+				{ "sql", show_sql },
+			};
+		
+		
+		
+		/* 
+		 * /status -
+		 * 
+		 * Displays load statistics gathered by the server, either all of them or
+		 * only those of the specified section.
+		 * 
+		 * Permissions:
+		 *   - command.info.status
+		 *       Needed to execute the command.
+		 */
+		void
+		c_status::execute (player *pl, command_reader& reader)
+		{
+			if (!pl->perm ("command.info.status"))
+				return;
+			
+			if (!reader.parse (this, pl))
+				return;
+			
+			if (reader.arg_count () > 1)
+				{ this->show_summary (pl); return; }
+			
+			if (reader.no_args ())
+				{
+					for (const status_section& sec : sections)
+						sec.show (pl);
+					return;
+				}
+			
+			std::string& name = reader.next ();
+			for (const status_section& sec : sections)
+				if (sutils::iequals (name, sec.name))
+					{
+						sec.show (pl);
+						return;
+					}
+			
+			pl->message ("§c * §7Unknown section§f: §c" + name);
+		}
+	}
+}
+
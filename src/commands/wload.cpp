@@ -30,17 +30,20 @@ namespace hCraft {
 		static bool
 		add_to_autoload (server& srv, const std::string& world_name)
 		{
+			srv.flush_sql_writes (); // see pending inserts
+			
 			auto& conn = srv.sql ().pop ();
-			int count = conn.query (
-				"SELECT count(*) FROM `autoload-worlds` WHERE `name`='"
-				+ world_name + "'").step ().at (0).as_int ();
+			auto stmt = conn.query (
+				"SELECT count(*) FROM `autoload-worlds` WHERE `name`=?");
+			stmt.bind (1, world_name.c_str (), sql::pass_transient);
+			int count = stmt.step ().at (0).as_int ();
+			srv.sql ().push (conn);
 			if (count != 0)
 				return false;
 			
-			conn.execute (
-				"INSERT INTO `autoload-worlds` (`name`) VALUES ('"
-				+ world_name + "')");
-			srv.sql ().push (conn);
+			sql::deferred_write w {"INSERT INTO `autoload-worlds` (`name`) VALUES (?)"};
+			w.bind (1, world_name.c_str ());
+			srv.sql ().defer (std::move (w));
 			return true;
 		}
 		
@@ -522,12 +522,8 @@ namespace hCraft {
 		int ey = utils::max ((int)pt1.y, (int)pt2.y);
 		int ez = utils::max ((int)pt1.z, (int)pt2.z);
 		
-		for (int x = sx; x <= ex; ++x)
-			for (int y = sy; y <= ey; ++y)
-				for (int z = sz; z <= ez; ++z)
-					{
-						this->es.set (x, y, z, material.id, material.meta);
-					}
+		this->es.fill (block_pos (sx, sy, sz), block_pos (ex, ey, ez),
+			material.id, material.meta);
 		
 		return ((ex - sx + 1) * (ey - sy + 1) * (ez - sz + 1));
 	}
@@ -26,6 +26,26 @@
 
 namespace hCraft {
 	
+	/* 
+	 * Collects the players that can see any of the chunks in @{chunks} (a map
+	 * keyed by chunk position) into @{out}.
+	 */
+	template<typename MapT>
+	static void
+	collect_viewers (world *w, MapT& chunks, std::vector<player *>& out)
+	{
+		std::unordered_set<player *> seen;
+		std::vector<player *> viewers;
+		for (auto itr = chunks.begin (); itr != chunks.end (); ++itr)
+			{
+				w->get_interest ().get_viewers (itr->first.x, itr->first.z, viewers);
+				for (player *pl : viewers)
+					if (seen.insert (pl).second)
+						out.push_back (pl);
+			}
+	}
+	
+	
 	void
 	edit_stage::set_world (world *w, bool reset)
 	{
@@ -35,6 +55,21 @@ namespace hCraft {
 	}
 	
 	
+	/* 
+	 * Sets all blocks in the box bounded between @{min} and @{max}
+	 * (inclusive) to the specified block.
+	 */
+	void
+	edit_stage::fill (block_pos min, block_pos max, unsigned short id,
+		unsigned char meta)
+	{
+		for (int x = min.x; x <= max.x; ++x)
+			for (int y = min.y; y <= max.y; ++y)
+				for (int z = min.z; z <= max.z; ++z)
+					this->set (x, y, z, id, meta);
+	}
+	
+	
 	void
 	edit_stage::preview_to (player *pl, bool update_sbs)
 	{
@@ -71,6 +106,8 @@ namespace hCraft {
 	{
 		for (int i = 0; i < 8; ++i)
 			this->micro[i] = nullptr;
+		this->filled = false;
+		this->fill_val = 0xFFFF;
 	}
 	
 	des_subchunk::~des_subchunk ()
@@ -80,6 +117,39 @@ namespace hCraft {
 	}
 	
 	
+	// turns a filled subchunk back into microchunks.
+	void
+	des_subchunk::expand ()
+	{
+		if (!this->filled)
+			return;
+		
+		for (int i = 0; i < 8; ++i)
+			{
+				des_microchunk *micro = this->micro[i] = new des_microchunk ();
+				for (int j = 0; j < 512; ++j)
+					micro->data[j] = this->fill_val;
+			}
+		this->filled = false;
+	}
+	
+	// the number of blocks set.
+	int
+	des_subchunk::count ()
+	{
+		if (this->filled)
+			return 4096;
+		
+		int n = 0;
+		for (int i = 0; i < 8; ++i)
+			if (this->micro[i])
+				for (int j = 0; j < 512; ++j)
+					if ((this->micro[i]->data[j] >> 4) != 0xFFF)
+						++ n;
+		return n;
+	}
+	
+	
 	
 	des_chunk::des_chunk ()
 	{
@@ -119,6 +189,8 @@ namespace hCraft {
 		des_subchunk *sub = ch.subs[sy];
 		if (!sub)
 			sub = ch.subs[sy] = new des_subchunk ();
+		else if (sub->filled)
+			sub->expand ();
 		
 		int bx = x & 0xF;
 		int by = y & 0xF;
@@ -145,25 +217,32 @@ namespace hCraft {
 	blocki
 	dense_edit_stage::get (int x, int y, int z)
 	{
-		int cx = x >> 4;
-		int cz = z >> 4;
+		blocki bl;
+		if (this->lookup (x, y, z, bl))
+			return bl;
 		
-		des_chunk *ch;
-		auto itr = this->chunks.find ({cx, cz});
+		block_data bd = this->w->get_block (x, y, z);
+		return {bd.id, bd.meta};
+	}
+	
+	/* 
+	 * Stores the block staged at the given coordinates in @{out}.
+	 * Returns false if the block has not been modified.
+	 */
+	bool
+	dense_edit_stage::lookup (int x, int y, int z, blocki& out)
+	{
+		auto itr = this->chunks.find ({x >> 4, z >> 4});
 		if (itr == this->chunks.end ())
-			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
-			}
-		else
-			ch = &itr->second;
+			return false;
 		
-		int sy = y >> 4;
-		des_subchunk *sub = ch->subs[sy];
+		des_subchunk *sub = itr->second.subs[y >> 4];
 		if (!sub)
+			return false;
+		else if (sub->filled)
 			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
+				out = {(unsigned short)(sub->fill_val >> 4), (unsigned char)(sub->fill_val & 0xF)};
+				return true;
 			}
 		
 		int bx = x & 0xF;
@@ -172,20 +251,64 @@ namespace hCraft {
 		int m_index = ((by >> 3) << 2) | ((bz >> 3) << 1) | ((bx >> 3));
 		des_microchunk *micro = sub->micro[m_index];
 		if (!micro)
-			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
-			}
+			return false;
 		
 		int b_index = ((y & 0x7) << 6) | ((z & 0x7) << 3) | ((x & 0x7));
 		unsigned short val = micro->data[b_index];
 		if (val == 0xFFFF)
+			return false;
+		
+		out = {(unsigned short)(val >> 4), (unsigned char)(val & 0xF)};
+		return true;
+	}
+	
+	/* 
+	 * Checks whether any blocks are staged in the specified chunk.
+	 */
+	bool
+	dense_edit_stage::has_chunk (int cx, int cz)
+	{
+		return (this->chunks.find ({cx, cz}) != this->chunks.end ());
+	}
+	
+	/* 
+	 * Writes the blocks staged in the specified subchunk over the ones in
+	 * @{sub}. Returns false if nothing is staged there.
+	 */
+	bool
+	dense_edit_stage::overlay (int cx, int sy, int cz, subchunk *sub)
+	{
+		auto itr = this->chunks.find ({cx, cz});
+		if (itr == this->chunks.end ())
+			return false;
+		
+		des_subchunk *dsub = itr->second.subs[sy];
+		if (!dsub)
+			return false;
+		else if (dsub->filled)
 			{
-				block_data bd = this->w->get_block (x, y, z);
-				return {bd.id, bd.meta};
+				sub->fill (dsub->fill_val >> 4, dsub->fill_val & 0xF);
+				return true;
 			}
 		
-		return {(unsigned short)(val >> 4), (unsigned char)(val & 0xF)};
+		for (int mi = 0; mi < 8; ++mi)
+			{
+				des_microchunk *micro = dsub->micro[mi];
+				if (!micro)
+					continue;
+				
+				int mx = (mi & 1) << 3;
+				int my = ((mi >> 2) & 1) << 3; 
+				int mz = ((mi >> 1) & 1) << 3;
+				for (int i = 0; i < 512; ++i)
+					{
+						unsigned short val = micro->data[i];
+						if ((val >> 4) != 0xFFF)
+							sub->set_id_and_meta (mx | (i & 7), my | (i >> 6),
+								mz | ((i >> 3) & 7), val >> 4, val & 0xF);
+					}
+			}
+		return true;
 	}
 	
 	void
@@ -195,6 +318,137 @@ namespace hCraft {
 	}
 	
 	
+	/* 
+	 * Sets all blocks in the box bounded between @{min} and @{max}
+	 * (inclusive) to the specified block. Subchunks that are fully covered
+	 * by the box are filled as a whole, and are later committed to the world
+	 * in bulk.
+	 */
+	void
+	dense_edit_stage::fill (block_pos min, block_pos max, unsigned short id,
+		unsigned char meta)
+	{
+		if (min.y < 0) min.y = 0;
+		if (max.y > 255) max.y = 255;
+		if (min.x > max.x || min.y > max.y || min.z > max.z)
+			return;
+		
+		for (int cx = (min.x >> 4); cx <= (max.x >> 4); ++cx)
+			for (int cz = (min.z >> 4); cz <= (max.z >> 4); ++cz)
+				{
+					int x0 = (min.x > (cx << 4)) ? min.x : (cx << 4);
+					int x1 = (max.x < ((cx << 4) + 15)) ? max.x : ((cx << 4) + 15);
+					int z0 = (min.z > (cz << 4)) ? min.z : (cz << 4);
+					int z1 = (max.z < ((cz << 4) + 15)) ? max.z : ((cz << 4) + 15);
+					bool full_xz = ((x1 - x0) == 15) && ((z1 - z0) == 15);
+					
+					for (int sy = (min.y >> 4); sy <= (max.y >> 4); ++sy)
+						{
+							int y0 = (min.y > (sy << 4)) ? min.y : (sy << 4);
+							int y1 = (max.y < ((sy << 4) + 15)) ? max.y : ((sy << 4) + 15);
+							
+							if (full_xz && ((y1 - y0) == 15))
+								{
+									des_chunk& ch = this->chunks[{cx, cz}];
+									des_subchunk *sub = ch.subs[sy];
+									if (sub)
+										{
+											ch.mod_count -= sub->count ();
+											delete sub;
+										}
+									
+									sub = ch.subs[sy] = new des_subchunk ();
+									sub->filled = true;
+									sub->fill_val = (id << 4) | (meta & 0xF);
+									ch.mod_count += 4096;
+									continue;
+								}
+							
+							for (int y = y0; y <= y1; ++y)
+								for (int z = z0; z <= z1; ++z)
+									for (int x = x0; x <= x1; ++x)
+										this->set (x, y, z, id, meta);
+						}
+				}
+	}
+	
+	/* 
+	 * Discards all modifications made to the specified subchunk.
+	 */
+	void
+	dense_edit_stage::reset_subchunk (int cx, int sy, int cz)
+	{
+		auto itr = this->chunks.find ({cx, cz});
+		if (itr == this->chunks.end ())
+			return;
+		
+		des_chunk& ch = itr->second;
+		des_subchunk *sub = ch.subs[sy];
+		if (sub)
+			{
+				ch.mod_count -= sub->count ();
+				delete sub;
+				ch.subs[sy] = nullptr;
+			}
+	}
+	
+	/* 
+	 * Discards modifications made to blocks that are also modified by
+	 * @{other}.
+	 */
+	void
+	dense_edit_stage::subtract (dense_edit_stage& other)
+	{
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); )
+			{
+				auto oitr = other.chunks.find (itr->first);
+				if (oitr == other.chunks.end ())
+					{ ++ itr; continue; }
+				
+				des_chunk& ch = itr->second;
+				des_chunk& och = oitr->second;
+				for (int sy = 0; sy < 16; ++sy)
+					{
+						des_subchunk *sub = ch.subs[sy];
+						des_subchunk *osub = och.subs[sy];
+						if (!sub || !osub)
+							continue;
+						
+						if (osub->filled)
+							{
+								ch.mod_count -= sub->count ();
+								delete sub;
+								ch.subs[sy] = nullptr;
+								continue;
+							}
+						else if (sub->filled)
+							sub->expand ();
+						
+						for (int mi = 0; mi < 8; ++mi)
+							{
+								des_microchunk *micro = sub->micro[mi];
+								des_microchunk *omicro = osub->micro[mi];
+								if (!micro || !omicro)
+									continue;
+								
+								for (int i = 0; i < 512; ++i)
+									if (((micro->data[i] >> 4) != 0xFFF) &&
+											((omicro->data[i] >> 4) != 0xFFF))
+										{
+											micro->data[i] = 0xFFFF;
+											-- ch.mod_count;
+										}
+							}
+					}
+				
+				if (ch.mod_count == 0)
+					itr = this->chunks.erase (itr);
+				else
+					++ itr;
+			}
+	}
+	
+	
 	
 	void
 	dense_edit_stage::send_to_players (std::vector<player *>& _players,
@@ -229,11 +483,12 @@ namespace hCraft {
 				for (int mi = 0; mi < 8; ++mi)
 					{
 						des_microchunk *micro = sub->micro[mi];
-						if (!micro) continue;
+						if (!micro && !sub->filled) continue;
 						
 						for (int bi = 0; bi < 512; ++bi)
 							{
-								id = micro->data[bi] >> 4;
+								unsigned short val = sub->filled ? sub->fill_val : micro->data[bi];
+								id = val >> 4;
 								if (id != 0xFFF)
 									{
 										bx = ((mi & 1) << 3) | (bi & 0x7);
@@ -247,7 +502,7 @@ namespace hCraft {
 												meta = bd.meta;
 											}
 										else
-											meta = micro->data[bi] & 0xF;
+											meta = val & 0xF;
 										
 										records.push_back ({(unsigned char)bx, (unsigned char)by, (unsigned char)bz, id, meta});
 									}
@@ -271,6 +526,23 @@ namespace hCraft {
 	
 	
 	
+	/* 
+	 * Sends all modified blocks to the players that can see them.
+	 */
+	void
+	dense_edit_stage::preview_to_viewers (bool update_sbs)
+	{
+		std::vector<player *> viewers;
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			{
+				this->w->get_interest ().get_viewers (itr->first.x, itr->first.z, viewers);
+				if (!viewers.empty ())
+					this->send_to_players (viewers, itr->first.x, itr->first.z, itr->second,
+						false, update_sbs);
+			}
+	}
+	
+	
 	/* 
 	 * Sends all modified blocks to the specified player(s).
 	 */
@@ -310,188 +582,311 @@ namespace hCraft {
 	
 	
 	/* 
-	 * Commits all block modifications to the underlying world.
-	 * The edit stage is then cleared.
+	 * Writes a filled subchunk into the world in bulk.
+	 * The world's edit stage and lighting manager must be locked.
+	 * 
+	 * If @{phys} is not null, the blocks that might have to be activated
+	 * are appended to it (see activate_physics ()).
 	 */
 	void
-	dense_edit_stage::commit (bool physics)
+	dense_edit_stage::commit_filled (int cx, int sy, int cz, chunk *wch,
+		des_subchunk *sub, std::vector<unsigned short> *phys)
 	{
-		static const int chunk_cap = 3000;
+		unsigned short id = sub->fill_val >> 4;
+		unsigned char meta = sub->fill_val & 0xF;
 		
-		if (this->chunks.empty ())
-			return;
+		subchunk *wsub = wch->create_sub (sy);
+		wsub->fill (id, meta);
+		wch->modified = true;
 		
-		block_pos bound_min = { 0x7FFFFFFF,  0x7FFFFFFF, 0x7FFFFFFF};
-		block_pos bound_max = {-0x7FFFFFFF, -0x7FFFFFFF,-0x7FFFFFFF};
+		this->w->lm.mark_subchunk_nolock (cx, sy, cz);
 		
-		std::vector<player *> affected_players;
-		auto& chunks_ref = this->chunks;
-		this->w->get_players ().all (
-			[&affected_players, &chunks_ref] (player *pl)
-				{
-					bool found_common_chunk = false;
-					for (auto itr = chunks_ref.begin (); itr != chunks_ref.end (); ++itr)
-						{
-							if (pl->can_see_chunk (itr->first.x, itr->first.z))
-								{
-									found_common_chunk = true;
-									break;
-								}
-						}
-					
-					if (found_common_chunk)
-						affected_players.push_back (pl);
-				});
+		if (phys)
+			{
+				physics_block *ph = this->w->get_physics_of (id);
+				if (ph)
+					{
+						// blocks inside the subchunk are surrounded by copies of
+						// themselves, so unless that is enough to keep them active, only
+						// the ones on the surface have to be considered.
+						blocki same[6];
+						for (int i = 0; i < 6; ++i)
+							same[i] = {id, meta};
+						bool interior = ph->is_active (meta, same);
+						
+						for (int y = 0; y < 16; ++y)
+							for (int z = 0; z < 16; ++z)
+								for (int x = 0; x < 16; ++x)
+									{
+										if (interior || x == 0 || x == 15 || y == 0 || y == 15
+											|| z == 0 || z == 15)
+											phys->push_back ((((sy << 4) | y) << 8) | (z << 4) | x);
+									}
+					}
+			}
+	}
+	
+	
+	/* 
+	 * Returns the block at the given coordinates (relative to @{wch}, which
+	 * lies at @{cx}, @{cz}), as it will be once this edit stage is committed.
+	 */
+	blocki
+	dense_edit_stage::neighbour_block (chunk *wch, int cx, int cz,
+		int x, int y, int z)
+	{
+		if (y < 0) return {BT_BEDROCK};
+		if (y > 255) return {BT_AIR};
+		if (x >= 0 && x <= 15 && z >= 0 && z <= 15)
+			return {wch->get_id (x, y, z), wch->get_meta (x, y, z)};
 		
-		std::lock_guard<std::mutex> lm_guard ((this->w->lm.get_lock ()));
-		std::lock_guard<std::mutex> es_guard ((this->w->estage_lock));
-		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+		// neighbouring chunks might not have been committed yet.
+		blocki bl;
+		if (this->lookup ((cx << 4) + x, y, (cz << 4) + z, bl))
+			return bl;
+		
+		chunk *nch;
+		if (x < 0)
+			{ nch = wch->west; x = 15; }
+		else if (x > 15)
+			{ nch = wch->east; x = 0; }
+		else if (z < 0)
+			{ nch = wch->north; z = 15; }
+		else
+			{ nch = wch->south; z = 0; }
+		
+		if (!nch)
+			return {BT_AIR};
+		return {nch->get_id (x, y, z), nch->get_meta (x, y, z)};
+	}
+	
+	/* 
+	 * Queues physics updates for those of the specified blocks (given as
+	 * chunk-relative (y << 8) | (z << 4) | x indices into @{wch}) that could be
+	 * changed by their surroundings. Blocks buried inside a bulk edit are left
+	 * alone, and are woken up as usual once a neighbour changes.
+	 */
+	void
+	dense_edit_stage::activate_physics (int cx, int cz, chunk *wch,
+		const std::vector<unsigned short>& phys)
+	{
+		blocki nb[6];
+		for (unsigned short index : phys)
 			{
-				int cx = itr->first.x;
-				int cz = itr->first.z;
+				int x = index & 0xF;
+				int z = (index >> 4) & 0xF;
+				int y = index >> 8;
 				
-				chunk *wch = this->w->load_chunk (cx, cz);
-				if (wch == this->w->get_edge_chunk ())
+				physics_block *ph = this->w->get_physics_of (wch->get_id (x, y, z));
+				if (!ph)
 					continue;
-				des_chunk &ch = itr->second;
 				
-				std::vector<block_change_record> records;
-				bool add_records = (ch.mod_count < chunk_cap);
+				nb[0] = this->neighbour_block (wch, cx, cz, x - 1, y, z);
+				nb[1] = this->neighbour_block (wch, cx, cz, x + 1, y, z);
+				nb[2] = this->neighbour_block (wch, cx, cz, x, y - 1, z);
+				nb[3] = this->neighbour_block (wch, cx, cz, x, y + 1, z);
+				nb[4] = this->neighbour_block (wch, cx, cz, x, y, z - 1);
+				nb[5] = this->neighbour_block (wch, cx, cz, x, y, z + 1);
+				if (ph->is_active (wch->get_meta (x, y, z), nb))
+					this->w->queue_physics ((cx << 4) | x, y, (cz << 4) | z, 0, nullptr,
+						ph->tick_rate ());
+			}
+	}
+	
+	
+	/* 
+	 * Writes a single staged chunk into the world, and sends the changes to
+	 * those of the specified players that can see it. The world's lighting
+	 * manager must be locked.
+	 * 
+	 * @{bound_min} and @{bound_max} are extended to contain the modified
+	 * blocks. Returns the number of blocks written.
+	 */
+	int
+	dense_edit_stage::commit_chunk (int cx, int cz, des_chunk& ch,
+		std::vector<player *>& players, bool physics,
+		block_pos& bound_min, block_pos& bound_max)
+	{
+		static const int chunk_cap = 3000;
+		static const int region_light_cap = 1024;
+		
+		chunk *wch = this->w->load_chunk (cx, cz);
+		if (wch == this->w->get_edge_chunk ())
+			return 0;
+		
+		std::vector<block_change_record> records;
+		bool add_records = (ch.mod_count < chunk_cap);
+		
+		// when enough blocks are modified, the modified subchunks are relit as a
+		// whole instead of block by block.
+		bool region_light = (ch.mod_count >= region_light_cap);
+		
+		// physics blocks are only activated once the whole chunk is written.
+		std::vector<unsigned short> phys;
+		
+		std::bitset<256> column_changed;
+		
+		unsigned short id;
+		unsigned char meta;
+		int rx, ry, rz;
+		
+		for (int sy = 0; sy < 16; ++sy)
+			{
+				int yy = sy << 4;
+				des_subchunk *sub = ch.subs[sy];
+				if (!sub)
+					continue;
 				
-				std::bitset<256> column_changed;
+				if (sub->filled)
+					{
+						this->commit_filled (cx, sy, cz, wch, sub, physics ? &phys : nullptr);
+						column_changed.set ();
+						
+						// update boundaries
+						if ((cx << 4) < bound_min.x) bound_min.x = cx << 4;
+						if (((cx << 4) | 15) > bound_max.x) bound_max.x = (cx << 4) | 15;
+						if (yy < bound_min.y) bound_min.y = yy;
+						if ((yy | 15) > bound_max.y) bound_max.y = yy | 15;
+						if ((cz << 4) < bound_min.z) bound_min.z = cz << 4;
+						if (((cz << 4) | 15) > bound_max.z) bound_max.z = (cz << 4) | 15;
+						continue;
+					}
 				
-				unsigned short id;
-				unsigned char meta;
-				int rx, ry, rz;
+				if (region_light)
+					this->w->lm.mark_subchunk_nolock (cx, sy, cz);
 				
-				for (int sy = 0; sy < 16; ++sy)
+				for (int mi = 0; mi < 8; ++mi)
 					{
-						int yy = sy << 4;
-						des_subchunk *sub = ch.subs[sy];
-						if (!sub)
+						des_microchunk *micro = sub->micro[mi];
+						if (!micro)
 							continue;
 						
-						for (int mi = 0; mi < 8; ++mi)
-							{
-								des_microchunk *micro = sub->micro[mi];
-								if (!micro)
-									continue;
+						int mx = (mi & 1) << 3;
+						int my = ((mi >> 2) & 1) << 3; 
+						int mz = ((mi >> 1) & 1) << 3;
+						for (int x = 0; x < 8; ++x)
+							for (int z = 0; z < 8; ++z)
+								for (int y = 0; y < 8; ++y)
+									{
+										unsigned int index = (y << 6) | (z << 3) | x;
 								
-								int mx = (mi & 1) << 3;
-								int my = ((mi >> 2) & 1) << 3; 
-								int mz = ((mi >> 1) & 1) << 3;
-								for (int x = 0; x < 8; ++x)
-									for (int z = 0; z < 8; ++z)
-										for (int y = 0; y < 8; ++y)
+										id = micro->data[index] >> 4;
+										if (id != 0xFFF)
 											{
-												unsigned int index = (y << 6) | (z << 3) | x;
-										
-												id = micro->data[index] >> 4;
-												if (id != 0xFFF)
-													{
-														rx = mx | x;
-														ry = my | y;
-														rz = mz | z;
-														column_changed.set ((rz << 4) | rx);
-														
-														meta = micro->data[index] & 0xF;
-														if (add_records)
-															{
-																block_change_record rec;
-																rec.x = rx;
-																rec.z = rz;
-																rec.y = yy + ry;
-																rec.id = id;
-																rec.meta = meta;
-																records.push_back (rec);
-															}
+												rx = mx | x;
+												ry = my | y;
+												rz = mz | z;
+												column_changed.set ((rz << 4) | rx);
 												
-														int wx = (cx << 4) | rx;
-														int wy = yy | ry;
-														int wz = (cz << 4) | rz;
-														this->w->estage.set (wx, wy, wz, 0xFFF, 0xF);
-														
-														// update boundaries
-														if (wx < bound_min.x) bound_min.x = wx;
-														if (wx > bound_max.x) bound_max.x = wx;
-														if (wy < bound_min.y) bound_min.y = wy;
-														if (wy > bound_max.y) bound_max.y = wy;
-														if (wz < bound_min.z) bound_min.z = wz;
-														if (wz > bound_max.z) bound_max.z = wz;
-										
-														wch->set_id_and_meta (rx, wy, rz, id, meta);
-														
-														//if (this->w->auto_lighting)
-														// NOTE: we already acquired the lighting manager's lock,
-														//       so this is perfectly safe.
-														this->w->queue_lighting_nolock (wx, wy, wz);
-														
-														if (physics)
-															{
-																physics_block *ph = this->w->get_physics_of (id);
-																if (ph)
-																	this->w->queue_physics (wx, wy, wz, 0, nullptr, ph->tick_rate ());
-															}
+												meta = micro->data[index] & 0xF;
+												if (add_records)
+													{
+														block_change_record rec;
+														rec.x = rx;
+														rec.z = rz;
+														rec.y = yy + ry;
+														rec.id = id;
+														rec.meta = meta;
+														records.push_back (rec);
 													}
+										
+												int wx = (cx << 4) | rx;
+												int wy = yy | ry;
+												int wz = (cz << 4) | rz;
+												
+												// update boundaries
+												if (wx < bound_min.x) bound_min.x = wx;
+												if (wx > bound_max.x) bound_max.x = wx;
+												if (wy < bound_min.y) bound_min.y = wy;
+												if (wy > bound_max.y) bound_max.y = wy;
+												if (wz < bound_min.z) bound_min.z = wz;
+												if (wz > bound_max.z) bound_max.z = wz;
+								
+												wch->set_id_and_meta (rx, wy, rz, id, meta);
+												
+												//if (this->w->auto_lighting)
+												// NOTE: we already acquired the lighting manager's lock,
+												//       so this is perfectly safe.
+												if (!region_light)
+													this->w->queue_lighting_nolock (wx, wy, wz);
+												
+												if (physics && this->w->get_physics_of (id))
+													phys.push_back ((wy << 8) | (rz << 4) | rx);
 											}
-							}
+									}
 					}
-				
-				// adjust heightmap
-				for (int x = 0; x < 16; ++x)
-					for (int z = 0; z < 16; ++z) 
-						{
-							if (column_changed.test ((z << 4) | x))
-								wch->recalc_heightmap (x, z);
-						}
+			}
+		
+		// adjust heightmap
+		for (int x = 0; x < 16; ++x)
+			for (int z = 0; z < 16; ++z) 
+				{
+					if (column_changed.test ((z << 4) | x))
+						wch->recalc_heightmap (x, z);
+				}
+		
+		if (!phys.empty ())
+			this->activate_physics (cx, cz, wch, phys);
 
-				if (ch.mod_count >= chunk_cap)
+		if (ch.mod_count >= chunk_cap)
+			{
+				for (player *pl : players)
 					{
-						for (player *pl : affected_players)
-							{
-								if (pl->can_see_chunk (cx, cz))
-									pl->send (packet::make_chunk (cx, cz, wch));
-							}
+						if (pl->can_see_chunk (cx, cz))
+							pl->send (packet::make_chunk (cx, cz, wch));
 					}
-				else if (ch.mod_count > 200)
+			}
+		else if (ch.mod_count > 200)
+			{
+				packet *mbcp = packet::make_multi_block_change (cx, cz, records);
+				packet *cp   = packet::make_chunk (cx, cz, wch);
+
+				// send the smaller between the two
+				if (mbcp->size < cp->size)
 					{
-						packet *mbcp = packet::make_multi_block_change (cx, cz, records);
-						packet *cp   = packet::make_chunk (cx, cz, wch);
-		
-						// send the smaller between the two
-						if (mbcp->size < cp->size)
+						delete cp;
+						for (player *pl : players)
 							{
-								delete cp;
-								for (player *pl : affected_players)
-									{
-										pl->send (new packet (*mbcp));
-									}
-								delete mbcp;
-							}
-						else
-							{
-								delete mbcp;
-								for (player *pl : affected_players)
-									{
-										if (pl->can_see_chunk (cx, cz))
-											pl->send (new packet (*cp));
-									}
-								delete cp;
+								if (pl->can_see_chunk (cx, cz))
+									pl->send (new packet (*mbcp));
 							}
+						delete mbcp;
 					}
 				else
 					{
-						packet *pack = packet::make_multi_block_change (cx, cz, records);
-						for (player *pl : affected_players)
+						delete mbcp;
+						for (player *pl : players)
 							{
-								pl->send (new packet (*pack));
+								if (pl->can_see_chunk (cx, cz))
+									pl->send (new packet (*cp));
 							}
-						delete pack;
+						delete cp;
 					}
 			}
+		else
+			{
+				packet *pack = packet::make_multi_block_change (cx, cz, records);
+				for (player *pl : players)
+					{
+						if (pl->can_see_chunk (cx, cz))
+							pl->send (new packet (*pack));
+					}
+				delete pack;
+			}
 		
-		// update player selections
-		for (player *pl : affected_players)
+		return ch.mod_count;
+	}
+	
+	
+	/* 
+	 * Redraws selections that overlap the specified bounding box, and flushes
+	 * scoreboard changes, for all given players.
+	 */
+	void
+	dense_edit_stage::refresh_players (std::vector<player *>& players,
+		block_pos bound_min, block_pos bound_max)
+	{
+		for (player *pl : players)
 			{
 				for (auto itr = pl->selections.begin (); itr != pl->selections.end (); ++itr)
 					{
@@ -514,6 +909,144 @@ namespace hCraft {
 	}
 	
 	
+	/* 
+	 * Commits all block modifications to the underlying world.
+	 * The edit stage is then cleared.
+	 */
+	void
+	dense_edit_stage::commit (bool physics)
+	{
+		if (this->chunks.empty ())
+			return;
+		
+		block_pos bound_min = { 0x7FFFFFFF,  0x7FFFFFFF, 0x7FFFFFFF};
+		block_pos bound_max = {-0x7FFFFFFF, -0x7FFFFFFF,-0x7FFFFFFF};
+		
+		std::vector<player *> affected_players;
+		collect_viewers (this->w, this->chunks, affected_players);
+		
+		{
+			// block updates are held back until the edit is written, so that the
+			// world's edit stage only holds blocks older than it.
+			std::lock_guard<std::mutex> up_guard ((this->w->get_update_lock ()));
+			
+			// edits that are still being committed were made before this one.
+			for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+				this->w->commit_pending_at (itr->first.x, itr->first.z);
+			
+			this->w->drop_updates (
+				[this] (int x, int y, int z)
+					{
+						blocki bl;
+						return this->lookup (x, y, z, bl);
+					});
+			
+			std::lock_guard<std::mutex> lm_guard ((this->w->lm.get_lock ()));
+			{
+				std::lock_guard<std::mutex> es_guard ((this->w->estage_lock));
+				this->w->estage.subtract (*this);
+			}
+			
+			for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+				this->commit_chunk (itr->first.x, itr->first.z, itr->second,
+					affected_players, physics, bound_min, bound_max);
+		}
+		
+		this->refresh_players (affected_players, bound_min, bound_max);
+	}
+	
+	
+	/* 
+	 * Commits a single staged chunk to the world and removes it from the stage.
+	 * Unlike commit (), locks are only held while the chunk is being written,
+	 * which allows huge edits to be applied in bounded slices.
+	 * 
+	 * If @{erase_lock} is not null, it is held while the chunk is removed, so
+	 * that lookups protected by the same mutex never observe a half-erased
+	 * entry. Returns the number of blocks written, or -1 if the stage is empty.
+	 */
+	int
+	dense_edit_stage::commit_next (bool physics, block_pos& bound_min,
+		block_pos& bound_max, std::mutex *erase_lock)
+	{
+		auto itr = this->chunks.begin ();
+		if (itr == this->chunks.end ())
+			return -1;
+		
+		return this->commit_at (itr->first.x, itr->first.z, physics, bound_min,
+			bound_max, erase_lock);
+	}
+	
+	/* 
+	 * Same as commit_next (), but commits the specified chunk.
+	 * Returns -1 if nothing is staged in it.
+	 */
+	int
+	dense_edit_stage::commit_at (int cx, int cz, bool physics,
+		block_pos& bound_min, block_pos& bound_max, std::mutex *erase_lock)
+	{
+		auto itr = this->chunks.find ({cx, cz});
+		if (itr == this->chunks.end ())
+			return -1;
+		
+		std::vector<player *> players;
+		this->w->get_interest ().get_viewers (cx, cz, players);
+		
+		int count;
+		{
+			std::lock_guard<std::mutex> lm_guard ((this->w->lm.get_lock ()));
+			count = this->commit_chunk (cx, cz, itr->second, players, physics,
+				bound_min, bound_max);
+		}
+		
+		if (erase_lock)
+			{
+				std::lock_guard<std::mutex> guard {*erase_lock};
+				this->chunks.erase (itr);
+			}
+		else
+			this->chunks.erase (itr);
+		return count;
+	}
+	
+	
+	/* 
+	 * Hands all staged modifications over to the world, which then commits
+	 * them gradually over the next few ticks, reporting progress to
+	 * @{initiator} (if not null). @{done_msg}, if not empty, is sent to the
+	 * initiator once the last slice has been committed. The edit stage is
+	 * left empty.
+	 */
+	void
+	dense_edit_stage::commit_sliced (player *initiator, bool physics,
+		const std::string& done_msg)
+	{
+		if (this->chunks.empty ())
+			{
+				if (initiator && !done_msg.empty ())
+					initiator->message (done_msg);
+				return;
+			}
+		
+		dense_edit_stage *stage = new dense_edit_stage (this->w);
+		stage->chunks.swap (this->chunks);
+		this->w->queue_commit (stage, physics, initiator, done_msg);
+	}
+	
+	
+	/* 
+	 * Returns the number of blocks modified by this edit stage.
+	 */
+	int
+	dense_edit_stage::size ()
+	{
+		int count = 0;
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			count += itr->second.mod_count;
+		return count;
+	}
+	
+	
 	
 	/* 
 	 * Clears the edit stage.
@@ -726,23 +1259,7 @@ namespace hCraft {
 	sparse_edit_stage::commit (bool physics)
 	{
 		std::vector<player *> affected_players;
-		auto& chunks_ref = this->chunks;
-		this->w->get_players ().all (
-			[&affected_players, &chunks_ref] (player *pl)
-				{
-					bool found_common_chunk = false;
-					for (auto itr = chunks_ref.begin (); itr != chunks_ref.end (); ++itr)
-						{
-							if (pl->can_see_chunk (itr->first.x, itr->first.z))
-								{
-									found_common_chunk = true;
-									break;
-								}
-						}
-					
-					if (found_common_chunk)
-						affected_players.push_back (pl);
-				});
+		collect_viewers (this->w, this->chunks, affected_players);
 		
 		int x, y, z;
 		int wx, wz;
@@ -750,6 +1267,24 @@ namespace hCraft {
 		unsigned char meta;
 		std::vector<sb_correction> corrections;
 		
+		// block updates are held back until the edit is written, so that the
+		// world's edit stage only holds blocks older than it.
+		std::lock_guard<std::mutex> up_guard ((this->w->get_update_lock ()));
+		
+		// edits that are still being committed were made before this one.
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			this->w->commit_pending_at (itr->first.x, itr->first.z);
+		
+		auto& chunks_ref = this->chunks;
+		this->w->drop_updates (
+			[&chunks_ref] (int x, int y, int z)
+				{
+					auto itr = chunks_ref.find ({x >> 4, z >> 4});
+					return (itr != chunks_ref.end ()) && (itr->second.changes.find (
+						{(unsigned char)(x & 15), y, (unsigned char)(z & 15)})
+							!= itr->second.changes.end ());
+				});
+		
 		std::lock_guard<std::mutex> lm_guard ((this->w->lm.get_lock ()));
 		std::lock_guard<std::mutex> es_guard ((this->w->estage_lock));
 		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
@@ -777,7 +1312,10 @@ namespace hCraft {
 						wz = (cz << 4) | z;
 						
 						column_changed.set ((z << 4) | x);
-						this->w->estage.set (wx, y, wz, 0xFFF, 0xF);
+						
+						// NOTE: safe, since no newer updates can be queued while the
+						//       update lock is held.
+						this->w->estage.reset (wx, y, wz);
 						
 						// selection blocks
 						for (player *pl : affected_players)
@@ -19,6 +19,7 @@
 #include "entity.hpp"
 #include "player.hpp"
 #include <cstring>
+#include <cmath>
 
 
 namespace hCraft {
@@ -112,6 +113,139 @@ namespace hCraft {
 	
 //----
 	
+	entity_tracker::entity_tracker ()
+	{
+		this->x = this->y = this->z = 0;
+		this->r = this->l = 0.0f;
+		this->br = this->bl = 0;
+		this->updates = 0;
+		this->valid = false;
+		this->out_len = 0;
+	}
+	
+	
+	static inline unsigned char
+	encode_angle (float a)
+		{ return (unsigned char)(std::fmod (std::floor (a), 360.0f) / 360.0 * 256.0); }
+	
+	static inline unsigned char*
+	encode_int (unsigned char *ptr, int val)
+	{
+		*ptr++ = (val >> 24) & 0xFF;
+		*ptr++ = (val >> 16) & 0xFF;
+		*ptr++ = (val >>  8) & 0xFF;
+		*ptr++ = (val      ) & 0xFF;
+		return ptr;
+	}
+	
+	/* 
+	 * Compares @{pos} with the last broadcast state, and encodes the packets
+	 * needed to bring viewers up to date into @{out}. Returns the number
+	 * of bytes encoded (zero if nothing changed).
+	 */
+	int
+	entity_tracker::update (int eid, const entity_pos& pos)
+	{
+		const static int teleport_interval = 400; // updates (~20 seconds)
+		
+		int nx = (int)std::floor (pos.x * 32.0);
+		int ny = (int)std::floor (pos.y * 32.0);
+		int nz = (int)std::floor (pos.z * 32.0);
+		unsigned char nbr = encode_angle (pos.r);
+		unsigned char nbl = encode_angle (pos.l);
+		
+		int dx = nx - this->x, dy = ny - this->y, dz = nz - this->z;
+		bool moved = (dx != 0) || (dy != 0) || (dz != 0);
+		bool looked = (nbr != this->br) || (nbl != this->bl);
+		
+		unsigned char *ptr = this->out;
+		if (!this->valid || ((moved || looked) && (++ this->updates >= teleport_interval))
+			|| dx < -128 || dx > 127 || dy < -128 || dy > 127 || dz < -128 || dz > 127)
+			{
+				// absolute position, also corrects any accumulated rounding drift.
+				*ptr++ = 0x22;
+				ptr = encode_int (ptr, eid);
+				ptr = encode_int (ptr, nx);
+				ptr = encode_int (ptr, ny);
+				ptr = encode_int (ptr, nz);
+				*ptr++ = nbr;
+				*ptr++ = nbl;
+				this->updates = 0;
+				looked = true; // for the head look
+			}
+		else if (moved && looked)
+			{
+				*ptr++ = 0x21;
+				ptr = encode_int (ptr, eid);
+				*ptr++ = (unsigned char)dx;
+				*ptr++ = (unsigned char)dy;
+				*ptr++ = (unsigned char)dz;
+				*ptr++ = nbr;
+				*ptr++ = nbl;
+			}
+		else if (moved)
+			{
+				*ptr++ = 0x1F;
+				ptr = encode_int (ptr, eid);
+				*ptr++ = (unsigned char)dx;
+				*ptr++ = (unsigned char)dy;
+				*ptr++ = (unsigned char)dz;
+			}
+		else if (looked)
+			{
+				*ptr++ = 0x20;
+				ptr = encode_int (ptr, eid);
+				*ptr++ = nbr;
+				*ptr++ = nbl;
+			}
+		
+		if (looked)
+			{
+				// head look
+				*ptr++ = 0x23;
+				ptr = encode_int (ptr, eid);
+				*ptr++ = nbr;
+			}
+		
+		this->x = nx; this->y = ny; this->z = nz;
+		this->r = pos.r; this->l = pos.l;
+		this->br = nbr; this->bl = nbl;
+		this->valid = true;
+		
+		this->out_len = ptr - this->out;
+		return this->out_len;
+	}
+	
+	/* 
+	 * Encodes the last broadcast state as absolute packets (a teleport and a
+	 * head look) into @{out}, which must be able to hold 32 bytes. Used to
+	 * resynchronize viewers that missed updates. Returns the number of bytes
+	 * encoded (zero if nothing was broadcast yet).
+	 */
+	int
+	entity_tracker::encode_state (int eid, unsigned char *out) const
+	{
+		if (!this->valid)
+			return 0;
+		
+		unsigned char *ptr = out;
+		*ptr++ = 0x22;
+		ptr = encode_int (ptr, eid);
+		ptr = encode_int (ptr, this->x);
+		ptr = encode_int (ptr, this->y);
+		ptr = encode_int (ptr, this->z);
+		*ptr++ = this->br;
+		*ptr++ = this->bl;
+		
+		*ptr++ = 0x23;
+		ptr = encode_int (ptr, eid);
+		*ptr++ = this->br;
+		
+		return ptr - out;
+	}
+	
+	
+	
 	/* 
 	 * Constructs a new entity with the specified identification number.
 	 */
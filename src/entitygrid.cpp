@@ -0,0 +1,203 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "entitygrid.hpp"
+#include "entity.hpp"
+#include <algorithm>
+#include <cmath>
+
+
+namespace hCraft {
+	
+	static inline unsigned long long
+	cell_key (int x, int y, int z)
+	{
+		return ((unsigned long long)(x & 0x1FFFFF) << 42)
+			| ((unsigned long long)(y & 0x1FFFFF) << 21)
+			| (unsigned long long)(z & 0x1FFFFF);
+	}
+	
+	static inline double
+	dist_sq (const entity_pos& a, const entity_pos& b)
+	{
+		double dx = a.x - b.x, dy = a.y - b.y, dz = a.z - b.z;
+		return dx*dx + dy*dy + dz*dz;
+	}
+	
+	
+	
+	entity_grid::entity_grid (int cell_shift)
+	{
+		this->shift = cell_shift;
+	}
+	
+	
+	
+	unsigned long long
+	entity_grid::cell_of (const entity_pos& pos)
+	{
+		return cell_key ((int)std::floor (pos.x) >> this->shift,
+			(int)std::floor (pos.y) >> this->shift,
+			(int)std::floor (pos.z) >> this->shift);
+	}
+	
+	void
+	entity_grid::remove_from_cell (entity *e, unsigned long long key)
+	{
+		auto itr = this->cells.find (key);
+		if (itr == this->cells.end ())
+			return;
+		
+		std::vector<entity *>& vec = itr->second;
+		auto eitr = std::find (vec.begin (), vec.end (), e);
+		if (eitr != vec.end ())
+			{
+				*eitr = vec.back ();
+				vec.pop_back ();
+			}
+		if (vec.empty ())
+			this->cells.erase (itr);
+	}
+	
+	
+	
+	/* 
+	 * Inserts the specified entity into the cell that contains its current
+	 * position.
+	 */
+	void
+	entity_grid::insert (entity *e)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		if (this->where.find (e) != this->where.end ())
+			return;
+		
+		unsigned long long key = this->cell_of (e->pos);
+		this->cells[key].push_back (e);
+		this->where[e] = key;
+	}
+	
+	/* 
+	 * Removes the specified entity from the grid.
+	 */
+	void
+	entity_grid::remove (entity *e)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->where.find (e);
+		if (itr == this->where.end ())
+			return;
+		
+		this->remove_from_cell (e, itr->second);
+		this->where.erase (itr);
+	}
+	
+	/* 
+	 * Should be called after an entity's position changes. Moves the entity
+	 * to another cell if it has to.
+	 */
+	void
+	entity_grid::move (entity *e)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->where.find (e);
+		if (itr == this->where.end ())
+			return;
+		
+		unsigned long long key = this->cell_of (e->pos);
+		if (key == itr->second)
+			return;
+		
+		this->remove_from_cell (e, itr->second);
+		this->cells[key].push_back (e);
+		itr->second = key;
+	}
+	
+	
+	
+	/* 
+	 * Stores all entities that are within @{radius} blocks of @{center}, and
+	 * satisfy @{pred} (if given), in @{out}. The predicate is called while
+	 * the grid is locked.
+	 */
+	void
+	entity_grid::query_radius (const entity_pos& center, double radius,
+		std::vector<entity *>& out, std::function<bool (entity *)> pred)
+	{
+		double r_sq = radius * radius;
+		auto check = [&] (const std::vector<entity *>& vec)
+			{
+				for (entity *e : vec)
+					if ((dist_sq (e->pos, center) <= r_sq) && (!pred || pred (e)))
+						out.push_back (e);
+			};
+		
+		int x1 = (int)std::floor (center.x - radius) >> this->shift;
+		int y1 = (int)std::floor (center.y - radius) >> this->shift;
+		int z1 = (int)std::floor (center.z - radius) >> this->shift;
+		int x2 = (int)std::floor (center.x + radius) >> this->shift;
+		int y2 = (int)std::floor (center.y + radius) >> this->shift;
+		int z2 = (int)std::floor (center.z + radius) >> this->shift;
+		unsigned long long span = (unsigned long long)(x2 - x1 + 1)
+			* (y2 - y1 + 1) * (z2 - z1 + 1);
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		if (span > this->cells.size ())
+			{
+				// cheaper to go through the occupied cells.
+				for (auto itr = this->cells.begin (); itr != this->cells.end (); ++itr)
+					check (itr->second);
+				return;
+			}
+		
+		for (int x = x1; x <= x2; ++x)
+			for (int y = y1; y <= y2; ++y)
+				for (int z = z1; z <= z2; ++z)
+					{
+						auto itr = this->cells.find (cell_key (x, y, z));
+						if (itr != this->cells.end ())
+							check (itr->second);
+					}
+	}
+	
+	/* 
+	 * Stores the (no more than) @{k} entities closest to @{center}, within
+	 * @{radius} blocks and satisfying @{pred} (if given), in @{out}, closest
+	 * first.
+	 */
+	void
+	entity_grid::nearest (const entity_pos& center, int k, double radius,
+		std::vector<entity *>& out, std::function<bool (entity *)> pred)
+	{
+		std::vector<entity *> found;
+		this->query_radius (center, radius, found, pred);
+		
+		auto closer = [&center] (entity *a, entity *b)
+			{ return dist_sq (a->pos, center) < dist_sq (b->pos, center); };
+		if ((int)found.size () > k)
+			{
+				std::partial_sort (found.begin (), found.begin () + k, found.end (), closer);
+				found.resize (k);
+			}
+		else
+			std::sort (found.begin (), found.end (), closer);
+		
+		out.insert (out.end (), found.begin (), found.end ());
+	}
+}
+
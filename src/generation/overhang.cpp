@@ -171,8 +171,11 @@ namespace hCraft {
 #define OFFSET_LEVEL 60
 #define WATER_LEVEL  55
 #define MAX_HEIGHT  100
+	/* 
+	 * Generates terrain on the specified chunk.
+	 */
 	void
-	overhang_world_generator::terrain (world& wr, chunk *out, int cx, int cz)
+	overhang_world_generator::generate (world& wr, chunk *out, int cx, int cz)
 	{
 		int x, y, z;
 		double v, b;
@@ -199,6 +202,9 @@ namespace hCraft {
 	
 	
 	
+	/* 
+	 * Places grass, plants and trees on top of generated terrain.
+	 */
 	void
 	overhang_world_generator::decorate (world& wr, chunk *out, int cx, int cz)
 	{
@@ -211,6 +217,8 @@ namespace hCraft {
 		
 		unsigned int xz_hash = std::hash<long> () (((long)cz << 32) | cx) & 0xFFFFFFFF;
 		this->rnd.seed (this->gen_seed + xz_hash);
+		this->gen_oak_trees.seed (this->gen_seed + xz_hash);
+		this->gen_birch_trees.seed (this->gen_seed + xz_hash + 1);
 		std::uniform_int_distribution<> dis (1, 180);
 		
 		int d;
@@ -286,15 +294,5 @@ namespace hCraft {
 						}
 				}
 	}
-	
-	/* 
-	 * Generates on the specified chunk.
-	 */
-	void
-	overhang_world_generator::generate (world& wr, chunk *out, int cx, int cz)
-	{ 
-		this->terrain (wr, out, cx, cz);
-		this->decorate (wr, out, cx, cz);
-	}
 }
 
@@ -50,6 +50,10 @@ namespace hCraft {
 	{
 		static const int water_cap = 59;
 		std::minstd_rand rnd (this->gen_seed + cx * 1917 + cz * 3947);
+		
+		// trees must be reproducible on a per-chunk basis too, so that the chunk
+		// can be regenerated instead of saved.
+		this->gen_trees.seed (this->gen_seed + cx * 1917 + cz * 3947);
 		std::uniform_int_distribution<> dis (0, 3);
 		
 		std::uniform_int_distribution<> tdis (0, 3000);
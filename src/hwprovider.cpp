@@ -666,6 +666,13 @@ namespace hCraft {
 	
 //----
 	
+	// chunk flags, stored in an optional byte after the biome array (chunks
+	// saved without it are complete).
+	enum
+		{
+			HWCF_PLACEHOLDER = 1, // not generated yet, only holds spilled blocks
+		};
+	
 	static unsigned char*
 	make_chunk_data (chunk *ch, unsigned int *out_size)
 	{
@@ -691,6 +698,7 @@ namespace hCraft {
 			}
 		data_size += 256; // biome array
 		data_size += 4; // bitmaps
+		data_size += 1; // flags
 		
 		/* 
 		 * Create and fill the array:
@@ -724,6 +732,8 @@ namespace hCraft {
 		std::memcpy (data + n, ch->get_biome_array (), 256);
 		n += 256;
 		
+		data[n++] = (ch->status < CS_DECORATED) ? HWCF_PLACEHOLDER : 0;
+		
 		*out_size = n;
 		return data;
 	}
@@ -1136,7 +1146,7 @@ namespace hCraft {
 	}
 	
 	static void
-	fill_chunk (chunk *ch, const unsigned char *data)
+	fill_chunk (chunk *ch, const unsigned char *data, unsigned int data_size)
 	{
 		unsigned int n = 0, i;
 		unsigned short primary_bitmap, add_bitmap;
@@ -1152,6 +1162,7 @@ namespace hCraft {
 					subchunk *sub = ch->create_sub (i, false);
 					sub->air_count = 4096;
 					sub->add_count = 0;
+					sub->phys_count = 0;
 					sub->add = nullptr;
 				}
 		
@@ -1181,7 +1192,10 @@ namespace hCraft {
 		std::memcpy (ch->get_biome_array (), data + n, 256);
 		n += 256;
 		
-		// calculate add\air count
+		unsigned char flags = (n < data_size) ? data[n++] : 0;
+		ch->status = (flags & HWCF_PLACEHOLDER) ? CS_EMPTY : CS_DECORATED;
+		
+		// calculate add\air\physics count
 		for (i = 0; i < 16; ++i)
 			{
 				subchunk *sub = ch->get_sub (i);
@@ -1199,6 +1213,15 @@ namespace hCraft {
 											++ sub->add_count;
 									}
 							}
+						
+						for (int j = 0; j < 4096; ++j)
+							{
+								unsigned short id = sub->ids[j];
+								if (sub->add)
+									id |= ((j & 1) ? (sub->add[j >> 1] >> 4) : (sub->add[j >> 1] & 0xF)) << 8;
+								if (subchunk::is_physics_id (id))
+									++ sub->phys_count;
+							}
 					}
 			}
 	}
@@ -1233,7 +1256,7 @@ namespace hCraft {
 			}
 		delete[] compressed;
 		
-		fill_chunk (ch, data);
+		fill_chunk (ch, data, (unsigned int)data_size);
 		delete[] data;
 		return true;
 	}
@@ -0,0 +1,139 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include "interest.hpp"
+#include <algorithm>
+
+
+namespace hCraft {
+	
+	static inline unsigned long long
+	interest_key (int cx, int cz)
+		{ return ((unsigned long long)((unsigned int)cz) << 32)
+			| (unsigned long long)((unsigned int)cx); }
+	
+	
+	
+	void
+	interest_index::remove_nolock (player *pl, unsigned long long key)
+	{
+		auto itr = this->viewers.find (key);
+		if (itr == this->viewers.end ())
+			return;
+		
+		std::vector<player *>& vec = itr->second;
+		auto pitr = std::find (vec.begin (), vec.end (), pl);
+		if (pitr != vec.end ())
+			{
+				*pitr = vec.back ();
+				vec.pop_back ();
+			}
+		if (vec.empty ())
+			this->viewers.erase (itr);
+	}
+	
+	
+	
+	/* 
+	 * Registers\unregisters the specified player as a viewer of the given
+	 * chunk.
+	 */
+	void
+	interest_index::add (player *pl, int cx, int cz)
+	{
+		unsigned long long key = interest_key (cx, cz);
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		if (this->views[pl].insert (key).second)
+			this->viewers[key].push_back (pl);
+	}
+	
+	void
+	interest_index::remove (player *pl, int cx, int cz)
+	{
+		unsigned long long key = interest_key (cx, cz);
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->views.find (pl);
+		if (itr == this->views.end () || itr->second.erase (key) == 0)
+			return;
+		
+		this->remove_nolock (pl, key);
+		if (itr->second.empty ())
+			this->views.erase (itr);
+	}
+	
+	/* 
+	 * Removes the specified player from the index.
+	 */
+	void
+	interest_index::remove (player *pl)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		
+		auto itr = this->views.find (pl);
+		if (itr == this->views.end ())
+			return;
+		
+		for (unsigned long long key : itr->second)
+			this->remove_nolock (pl, key);
+		this->views.erase (itr);
+	}
+	
+	/* 
+	 * Checks whether the specified player is viewing the given chunk.
+	 */
+	bool
+	interest_index::is_viewer (player *pl, int cx, int cz)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		
+		auto itr = this->views.find (pl);
+		if (itr == this->views.end ())
+			return false;
+		return (itr->second.find (interest_key (cx, cz)) != itr->second.end ());
+	}
+	
+	
+	
+	/* 
+	 * Stores the players that can see the given chunk in @{out} (which is
+	 * cleared first).
+	 */
+	void
+	interest_index::get_viewers (int cx, int cz, std::vector<player *>& out)
+	{
+		out.clear ();
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->viewers.find (interest_key (cx, cz));
+		if (itr != this->viewers.end ())
+			out.insert (out.end (), itr->second.begin (), itr->second.end ());
+	}
+	
+	/* 
+	 * Checks whether anybody can see the given chunk.
+	 */
+	bool
+	interest_index::has_viewers (int cx, int cz)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		return (this->viewers.find (interest_key (cx, cz)) != this->viewers.end ());
+	}
+}
+
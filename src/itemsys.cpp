@@ -0,0 +1,169 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "itemsys.hpp"
+#include "pickup.hpp"
+#include "world.hpp"
+#include "playerlist.hpp"
+#include "blocks.hpp"
+
+
+namespace hCraft {
+	
+	void
+	item_system::add (pickup_item *item)
+	{
+		if (item->sys_index != -1)
+			return;
+		
+		item->sys_index = (int)this->items.size ();
+		this->items.push_back (item);
+		this->xs.push_back (item->pos.x);
+		this->ys.push_back (item->pos.y);
+		this->zs.push_back (item->pos.z);
+		this->ages.push_back (0);
+		this->flags.push_back (0);
+	}
+	
+	void
+	item_system::remove (pickup_item *item)
+	{
+		int i = item->sys_index;
+		if (i < 0 || i >= (int)this->items.size () || this->items[i] != item)
+			return;
+		
+		// move the last item into the freed slot.
+		int last = (int)this->items.size () - 1;
+		if (i != last)
+			{
+				this->items[i] = this->items[last];
+				this->xs[i] = this->xs[last];
+				this->ys[i] = this->ys[last];
+				this->zs[i] = this->zs[last];
+				this->ages[i] = this->ages[last];
+				this->flags[i] = this->flags[last];
+				this->items[i]->sys_index = i;
+			}
+		
+		this->items.pop_back ();
+		this->xs.pop_back ();
+		this->ys.pop_back ();
+		this->zs.pop_back ();
+		this->ages.pop_back ();
+		this->flags.pop_back ();
+		item->sys_index = -1;
+	}
+	
+	
+	
+	/* 
+	 * Moves falling items down. Items that have landed are only checked again
+	 * every once in a while, in case the block below them disappears.
+	 */
+	void
+	item_system::fall (world &w, unsigned long long ticks)
+	{
+		const static unsigned int resting_interval = 20; // ticks
+		const static double fall_step = 0.1;
+		
+		bool check_resting = ((ticks % resting_interval) == 0);
+		int count = (int)this->items.size ();
+		for (int i = 0; i < count; ++i)
+			{
+				unsigned char f = this->flags[i];
+				if ((f & IF_RESTING) && !check_resting)
+					continue;
+				
+				double ny = this->ys[i] - fall_step;
+				if (w.get_id ((int)this->xs[i], (int)ny, (int)this->zs[i])
+					== BT_AIR) // TODO: fall through any transparent block
+					{
+						this->ys[i] = ny;
+						f = (f & ~IF_RESTING) | IF_MOVED;
+					}
+				else
+					f |= IF_RESTING;
+				this->flags[i] = f;
+			}
+	}
+	
+	/* 
+	 * Copies the positions of items that moved back to their objects.
+	 */
+	void
+	item_system::sync (world &w)
+	{
+		int count = (int)this->items.size ();
+		for (int i = 0; i < count; ++i)
+			if (this->flags[i] & IF_MOVED)
+				{
+					pickup_item *item = this->items[i];
+					item->pos.y = this->ys[i];
+					w.get_entity_grid ().move (item);
+					this->flags[i] &= ~IF_MOVED;
+				}
+	}
+	
+	
+	
+	/* 
+	 * Ticks all items, in phases (gravity, merging, pickups), and appends
+	 * the ones that should be despawned to @{expired}.
+	 */
+	void
+	item_system::tick (world &w, unsigned long long ticks,
+		std::vector<entity *>& expired)
+	{
+		const static unsigned int merge_interval = 200; // ticks
+		const static unsigned int pickup_delay = 100; // ticks (500ms)
+		
+		if (this->items.empty ())
+			return;
+		
+		this->fall (w, ticks);
+		this->sync (w);
+		
+		int count = (int)this->items.size ();
+		for (int i = 0; i < count; ++i)
+			{
+				unsigned int age = ++ this->ages[i];
+				if ((age % merge_interval) == 0 && !this->items[i]->expired ())
+					this->items[i]->merge_nearby (w);
+			}
+		
+		// nobody to give items to.
+		if (w.get_players ().count () > 0)
+			{
+				for (int i = 0; i < count; ++i)
+					{
+						if (this->ages[i] < pickup_delay)
+							continue;
+						
+						pickup_item *item = this->items[i];
+						if (!item->expired ())
+							item->try_pickup (w);
+					}
+			}
+		
+		for (int i = 0; i < count; ++i)
+			if (this->items[i]->expired ())
+				expired.push_back (this->items[i]);
+	}
+}
+
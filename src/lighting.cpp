@@ -24,9 +24,69 @@
 #include <utility>
 #include <bitset>
 #include <vector>
+#include <condition_variable>
+#include <cstring>
 
 namespace hCraft {
 	
+	light_queue::light_queue ()
+	{
+		for (int i = 0; i < 16; ++i)
+			this->dirty[i] = nullptr;
+	}
+	
+	light_queue::~light_queue ()
+	{
+		for (int i = 0; i < 16; ++i)
+			delete this->dirty[i];
+	}
+	
+	
+	// returns false if the position is already queued.
+	bool
+	light_queue::push (unsigned short index)
+	{
+		std::bitset<4096> *bits = this->dirty[index >> 12];
+		if (!bits)
+			bits = this->dirty[index >> 12] = new std::bitset<4096> ();
+		else if (bits->test (index & 0xFFF))
+			return false;
+		
+		bits->set (index & 0xFFF);
+		this->items.push_back (index);
+		return true;
+	}
+	
+	unsigned short
+	light_queue::pop ()
+	{
+		unsigned short index = this->items.front ();
+		this->items.pop_front ();
+		this->dirty[index >> 12]->reset (index & 0xFFF);
+		return index;
+	}
+	
+	void
+	light_queue::clear ()
+	{
+		this->items.clear ();
+		for (int i = 0; i < 16; ++i)
+			{
+				delete this->dirty[i];
+				this->dirty[i] = nullptr;
+			}
+	}
+	
+	
+	
+//----
+	
+	static inline unsigned long long
+	light_chunk_key (int cx, int cz)
+		{ return ((unsigned long long)((unsigned int)cz) << 32)
+			| (unsigned long long)((unsigned int)cx); }
+	
+	
 	/* 
 	 * Constructs a new lighting manager on top of the given world.
 	 */
@@ -34,13 +94,124 @@ namespace hCraft {
 		: log (log)
 	{
 		this->wr = wr;
-		this->sl_overloaded = false;
-		this->bl_overloaded = false;
+		this->sl_pending = 0;
+		this->bl_pending = 0;
 		this->limit = limit;
+		this->degraded = false;
+		this->overload_count = 0;
+		this->relit_count = 0;
+		this->pool = nullptr;
+	}
+	
+	/* 
+	 * Class destructor.
+	 */
+	lighting_manager::~lighting_manager ()
+	{
+		this->set_pool (nullptr);
+		for (light_chunk *lc : this->active)
+			delete lc;
+	}
+	
+	
+	
+	/* 
+	 * Returns a consistent snapshot of the manager's statistics.
+	 */
+	lighting_stats
+	lighting_manager::get_stats ()
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		
+		lighting_stats st;
+		st.degraded = this->degraded;
+		st.pending = this->sl_pending + this->bl_pending;
+		st.dirty_chunks = (int)this->dirty.size ();
+		st.region_chunks = (int)this->region_order.size ();
+		st.overloads = this->overload_count;
+		st.chunks_relit = this->relit_count;
+		return st;
 	}
 	
 	
 	
+	/* 
+	 * Sets the thread pool used in addition to the calling thread when
+	 * handling updates (null means everything is done on the calling
+	 * thread). The pool can be shared between several managers.
+	 */
+	void
+	lighting_manager::set_pool (thread_pool *pool)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		this->pool = pool;
+	}
+	
+	
+	
+	light_chunk*
+	lighting_manager::get_light_chunk (int cx, int cz)
+	{
+		unsigned long long key = light_chunk_key (cx, cz);
+		auto itr = this->chunks.find (key);
+		if (itr != this->chunks.end ())
+			return itr->second;
+		
+		light_chunk *lc = new light_chunk (cx, cz);
+		this->chunks[key] = lc;
+		this->active.push_back (lc);
+		return lc;
+	}
+	
+	void
+	lighting_manager::adjust_pending (int sl, int bl)
+	{
+		this->sl_pending += sl;
+		this->bl_pending += bl;
+		
+		if (!this->degraded && ((this->sl_pending >= this->limit)
+			|| (this->bl_pending >= this->limit)))
+			{
+				// the queues themselves are collapsed at the end of update(), any
+				// update enqueued from now on just marks its chunk as dirty.
+				this->degraded = true;
+				++ this->overload_count;
+				this->log (LT_WARNING) << "World \"" << this->wr->get_name () <<
+					"\": Too many lighting updates! (>= " << this->limit <<
+					"), falling back to whole-chunk relighting" << std::endl;
+			}
+	}
+	
+	void
+	lighting_manager::mark_dirty (int cx, int cz)
+	{
+		if (this->dirty_set.insert (light_chunk_key (cx, cz)).second)
+			this->dirty.emplace_back (cx, cz);
+	}
+	
+	/* 
+	 * Moves all queued updates into the dirty chunk set.
+	 */
+	void
+	lighting_manager::collapse_queues ()
+	{
+		for (light_chunk *lc : this->active)
+			{
+				this->mark_dirty (lc->cx, lc->cz);
+				delete lc;
+			}
+		this->active.clear ();
+		this->chunks.clear ();
+		this->sl_pending = 0;
+		this->bl_pending = 0;
+		
+		for (auto& pos : this->region_order)
+			this->mark_dirty (pos.first, pos.second);
+		this->region_order.clear ();
+		this->regions.clear ();
+	}
+	
+	
 	void
 	lighting_manager::enqueue_nolock (int x, int y, int z)
 	{
@@ -51,33 +222,90 @@ namespace hCraft {
 	void
 	lighting_manager::enqueue_sl_nolock (int x, int y, int z)
 	{
-		if (this->sl_overloaded)
+		if ((y < 0) || (y > 255))
 			return;
 		
-		this->sl_updates.emplace (x, y, z);
-		if ((int)this->sl_updates.size () >= this->limit)
-			{
-				this->sl_overloaded = true;
-				this->log (LT_WARNING) << "World \"" << this->wr->get_name () <<
-					"\": Too many (S)lighting updates! (>= " << this->limit << ")" << std::endl;
-			}
+		int cx = x >> 4, cz = z >> 4;
+		if (!this->wr->chunk_in_bounds (cx, cz))
+			return;
+		if (this->degraded)
+			{ this->mark_dirty (cx, cz); return; }
+		
+		light_chunk *lc = this->get_light_chunk (cx, cz);
+		if (lc->sl.push ((y << 8) | ((z & 0xF) << 4) | (x & 0xF)))
+			this->adjust_pending (1, 0);
 	}
 	
 	void
 	lighting_manager::enqueue_bl_nolock (int x, int y, int z)
 	{
-		if (this->bl_overloaded)
+		if ((y < 0) || (y > 255))
+			return;
+		
+		int cx = x >> 4, cz = z >> 4;
+		if (!this->wr->chunk_in_bounds (cx, cz))
 			return;
+		if (this->degraded)
+			{ this->mark_dirty (cx, cz); return; }
 		
-		this->bl_updates.emplace (x, y, z);
-		if ((int)this->bl_updates.size () >= this->limit)
+		light_chunk *lc = this->get_light_chunk (cx, cz);
+		if (lc->bl.push ((y << 8) | ((z & 0xF) << 4) | (x & 0xF)))
+			this->adjust_pending (0, 1);
+	}
+	
+	
+	void
+	lighting_manager::enqueue_sl_local (light_job& job, int x, int y, int z)
+	{
+		if ((y < 0) || (y > 255))
+			return;
+		if (x < 0 || x > 15 || z < 0 || z > 15)
 			{
-				this->bl_overloaded = true;
-				this->log (LT_WARNING) << "World \"" << this->wr->get_name () <<
-					"\": Too many (B)lighting updates! (>= " << this->limit << ")" << std::endl;
+				// handled once the job is done.
+				job.sl_out.emplace_back ((job.lc->cx << 4) + x, y, (job.lc->cz << 4) + z);
+				return;
 			}
+		
+		if (job.lc->sl.push ((y << 8) | (z << 4) | x))
+			++ job.sl_added;
 	}
 	
+	void
+	lighting_manager::enqueue_bl_local (light_job& job, int x, int y, int z)
+	{
+		if ((y < 0) || (y > 255))
+			return;
+		if (x < 0 || x > 15 || z < 0 || z > 15)
+			{
+				// handled once the job is done.
+				job.bl_out.emplace_back ((job.lc->cx << 4) + x, y, (job.lc->cz << 4) + z);
+				return;
+			}
+		
+		if (job.lc->bl.push ((y << 8) | (z << 4) | x))
+			++ job.bl_added;
+	}
+	
+	/* 
+	 * Marks the specified subchunk to be relit as part of a region, instead
+	 * of having updates queued for each of its modified blocks.
+	 * Not thread-safe.
+	 */
+	void
+	lighting_manager::mark_subchunk_nolock (int cx, int sy, int cz)
+	{
+		if (!this->wr->chunk_in_bounds (cx, cz))
+			return;
+		if (this->degraded)
+			{ this->mark_dirty (cx, cz); return; }
+		
+		auto res = this->regions.emplace (light_chunk_key (cx, cz), 0);
+		if (res.second)
+			this->region_order.emplace_back (cx, cz);
+		res.first->second |= (1 << sy);
+	}
+	
+	
 	/* 
 	 * Pushes a lighting update to the update queue.
 	 */
@@ -155,139 +383,6 @@ namespace hCraft {
 		return nl;
 	}
 	
-	static char
-	calc_sky_light (lighting_manager &lm, int x, int y, int z, fn_enqueue enq, void *p)
-	{
-		world *wr = lm.get_world ();
-		
-		int cx = x >> 4;
-		int cz = z >> 4;
-		int bx = x & 15;
-		int bz = z & 15;
-		chunk *ch = wr->get_chunk (cx, cz);
-		if (!ch) return 0;
-		
-		block_data this_block = ch->get_block (bx, y, bz);
-		block_info *this_info = block_info::from_id (this_block.id);
-		char nl;
-		
-		if (this_info->opacity == 15)
-			{
-				nl = 0;
-			}
-		else if ((y + 1) >= ch->get_height (bx, bz))
-			{
-				nl = 15 - this_info->opacity;
-			}
-		else
-			{
-				char sle = (bx < 15) ? ch->get_sky_light (bx + 1, y, bz)
-														 : (ch->east ? ch->east->get_sky_light (0, y, bz) : 0);
-				char slw = (bx >  0) ? ch->get_sky_light (bx - 1, y, bz)
-														 : (ch->west ? ch->west->get_sky_light (15, y, bz) : 0);
-				char slu = (y < 255) ? ch->get_sky_light (bx, y + 1, bz) : 15;
-				char sld = (y >   0) ? ch->get_sky_light (bx, y - 1, bz) : 0;
-				char sls = (bz < 15) ? ch->get_sky_light (bx, y, bz + 1)
-														 : (ch->south ? ch->south->get_sky_light (bx, y, 0) : 0);
-				char sln = (bz >  0) ? ch->get_sky_light (bx, y, bz - 1)
-														 : (ch->north ? ch->north->get_sky_light (bx, y, 15) : 0);
-				
-				char brightest = _max (sle, _max (slw, _max (slu, _max (sld, _max (sls, _max (sln, 0))))));
-				nl = brightest - this_info->opacity - 1;
-				if (nl < 0) nl = 0;
-			}
-		
-		if (this_block.sl != nl)
-			{
-				ch->set_sky_light (bx, y, bz, nl);
-				
-				enq (p, x + 1, y, z);
-				enq (p, x - 1, y, z);
-				if (y < 255) enq (p, x, y + 1, z);
-				if (y >   0) enq (p, x, y - 1, z);
-				enq (p, x, y, z + 1);
-				enq (p, x, y, z - 1);
-			}
-		
-		return nl;
-	}
-	
-	
-	static char
-	get_neighbour_bl (chunk *ch, int bx, int by, int bz)
-	{
-		if (by > 255) return 0;
-		if (by <   0) return 0;
-		
-		if (bx > 15)
-			{ bx = 0; ch = ch->east; if (!ch) return 0; }
-		if (bx <  0)
-			{ bx = 15; ch = ch->west; if (!ch) return 0; }
-		if (bz > 15)
-			{ bz = 0; ch = ch->south; if (!ch) return 0; }
-		if (bz <  0)
-			{ bz = 15; ch = ch->north; if (!ch) return 0; }
-		
-		block_data bd = ch->get_block (bx, by, bz);
-		block_info *binf = block_info::from_id (bd.id);
-		if (binf->opaque && (binf->luminance == 0))
-			return 0;
-		return bd.bl;
-	}
-	
-	 
-	static char
-	calc_block_light (lighting_manager& lm, int x, int y, int z, fn_enqueue enq, void *p)
-	{
-		world *wr = lm.get_world ();
-		
-		int cx = x >> 4;
-		int cz = z >> 4;
-		int bx = x & 15;
-		int bz = z & 15;
-		chunk *ch = wr->get_chunk (cx, cz);
-		if (!ch) return 0;
-		
-		block_data this_block = ch->get_block (bx, y, bz);
-		block_info *this_info = block_info::from_id (this_block.id);
-		char nl;
-		
-		if (this_info->opaque)
-			{
-				nl = this_info->luminance;
-			}
-		else
-			{
-				char ble = get_neighbour_bl (ch, bx + 1, y, bz);
-				char blw = get_neighbour_bl (ch, bx - 1, y, bz);
-				char blu = get_neighbour_bl (ch, bx, y + 1, bz);
-				char bld = get_neighbour_bl (ch, bx, y - 1, bz);
-				char bls = get_neighbour_bl (ch, bx, y, bz + 1);
-				char bln = get_neighbour_bl (ch, bx, y, bz - 1);
-		
-				char brightest = _max (ble, _max (blw, _max (blu, _max (bld, _max (bls, _max (bln, 0))))));
-				nl = brightest - 1 + this_info->luminance;
-				if (nl <  0) nl = 0;
-				else if (nl > 15) nl = 15;
-			}
-		
-		if (this_block.bl != nl)
-			{
-				ch->set_block_light (bx, y, bz, nl);
-				
-				enq (p, x + 1, y, z);
-				enq (p, x - 1, y, z);
-				if (y < 255) enq (p, x, y + 1, z);
-				if (y >   0) enq (p, x, y - 1, z);
-				enq (p, x, y, z + 1);
-				enq (p, x, y, z - 1);
-			}
-		
-		return nl;
-	}
-	
-	
-	
 	static void
 	chunk_enqueue_sl (void *param, int x, int y, int z)
 	{
@@ -348,57 +443,569 @@ namespace hCraft {
 	
 	
 	
-	static void
-	lm_enqueue_sl (void *param, int x, int y, int z)
+//----
+	
+	/* 
+	 * Direct access to nibble arrays and block IDs of subchunks.
+	 * @{i} is the index of the block within the subchunk.
+	 */
+	
+	static inline unsigned char
+	nib_get (const unsigned char *arr, unsigned int i)
+		{ return (i & 1) ? (arr[i >> 1] >> 4) : (arr[i >> 1] & 0xF); }
+	
+	static inline void
+	nib_set (unsigned char *arr, unsigned int i, unsigned char val)
 	{
-		lighting_manager *lm = static_cast<lighting_manager *> (param);
-		lm->enqueue_sl_nolock (x, y, z);
+		if (i & 1)
+			{ arr[i >> 1] &= 0x0F; arr[i >> 1] |= (val << 4); }
+		else
+			{ arr[i >> 1] &= 0xF0; arr[i >> 1] |= val; }
 	}
 	
-	static void
-	lm_enqueue_bl (void *param, int x, int y, int z)
+	static inline unsigned short
+	sub_id (subchunk *sub, unsigned int i)
+	{
+		unsigned short id = sub->ids[i];
+		if (sub->add_count > 0)
+			id |= nib_get (sub->add, i) << 8;
+		return id;
+	}
+	
+	
+	/* 
+	 * Follows neighbour links to the chunk that contains the given position
+	 * (relative to @{ch}), and adjusts the coordinates accordingly.
+	 */
+	static inline chunk*
+	resolve_neighbour (chunk *ch, int& x, int& z)
+	{
+		if (x > 15)
+			{ x = 0; return ch->east; }
+		else if (x < 0)
+			{ x = 15; return ch->west; }
+		else if (z > 15)
+			{ z = 0; return ch->south; }
+		else if (z < 0)
+			{ z = 15; return ch->north; }
+		return ch;
+	}
+	
+	static inline int
+	neighbour_sl (chunk *ch, int x, int y, int z)
+	{
+		if (y > 255) return 15;
+		if (y <   0) return 0;
+		
+		ch = resolve_neighbour (ch, x, z);
+		if (!ch) return 0;
+		
+		subchunk *sub = ch->get_sub (y >> 4);
+		if (!sub) return 15;
+		return nib_get (sub->slight, ((y & 0xF) << 8) | (z << 4) | x);
+	}
+	
+	static inline int
+	neighbour_bl (chunk *ch, int x, int y, int z)
+	{
+		if (y > 255) return 0;
+		if (y <   0) return 0;
+		
+		ch = resolve_neighbour (ch, x, z);
+		if (!ch) return 0;
+		
+		subchunk *sub = ch->get_sub (y >> 4);
+		if (!sub) return 0;
+		
+		unsigned int i = ((y & 0xF) << 8) | (z << 4) | x;
+		block_info *binf = block_info::from_id (sub_id (sub, i));
+		if (binf->opaque && (binf->luminance == 0))
+			return 0;
+		return nib_get (sub->blight, i);
+	}
+	
+	
+	void
+	lighting_manager::update_sky_light (light_job& job, unsigned short index)
+	{
+		chunk *ch = job.ch;
+		int x = index & 0xF;
+		int z = (index >> 4) & 0xF;
+		int y = index >> 8;
+		unsigned int i = index & 0xFFF;
+		
+		subchunk *sub = ch->get_sub (y >> 4);
+		block_info *this_info = block_info::from_id (sub ? sub_id (sub, i) : 0);
+		int sl = sub ? nib_get (sub->slight, i) : 15;
+		int nl;
+		
+		if (this_info->opacity == 15)
+			nl = 0;
+		else if ((y + 1) >= ch->get_height (x, z))
+			nl = 15 - this_info->opacity;
+		else
+			{
+				int brightest = _max (neighbour_sl (ch, x + 1, y, z),
+					_max (neighbour_sl (ch, x - 1, y, z),
+					_max (neighbour_sl (ch, x, y + 1, z),
+					_max (neighbour_sl (ch, x, y - 1, z),
+					_max (neighbour_sl (ch, x, y, z + 1),
+								neighbour_sl (ch, x, y, z - 1))))));
+				nl = brightest - this_info->opacity - 1;
+				if (nl < 0) nl = 0;
+			}
+		
+		if (sl != nl)
+			{
+				if (!sub)
+					sub = ch->create_sub (y >> 4);
+				nib_set (sub->slight, i, nl);
+				ch->relit = true;
+				
+				this->enqueue_sl_local (job, x + 1, y, z);
+				this->enqueue_sl_local (job, x - 1, y, z);
+				this->enqueue_sl_local (job, x, y + 1, z);
+				this->enqueue_sl_local (job, x, y - 1, z);
+				this->enqueue_sl_local (job, x, y, z + 1);
+				this->enqueue_sl_local (job, x, y, z - 1);
+			}
+	}
+	
+	void
+	lighting_manager::update_block_light (light_job& job, unsigned short index)
+	{
+		chunk *ch = job.ch;
+		int x = index & 0xF;
+		int z = (index >> 4) & 0xF;
+		int y = index >> 8;
+		unsigned int i = index & 0xFFF;
+		
+		subchunk *sub = ch->get_sub (y >> 4);
+		block_info *this_info = block_info::from_id (sub ? sub_id (sub, i) : 0);
+		int bl = sub ? nib_get (sub->blight, i) : 0;
+		int nl;
+		
+		if (this_info->opaque)
+			nl = this_info->luminance;
+		else
+			{
+				int brightest = _max (neighbour_bl (ch, x + 1, y, z),
+					_max (neighbour_bl (ch, x - 1, y, z),
+					_max (neighbour_bl (ch, x, y + 1, z),
+					_max (neighbour_bl (ch, x, y - 1, z),
+					_max (neighbour_bl (ch, x, y, z + 1),
+								neighbour_bl (ch, x, y, z - 1))))));
+				nl = brightest - 1 + this_info->luminance;
+				if (nl <  0) nl = 0;
+				else if (nl > 15) nl = 15;
+			}
+		
+		if (bl != nl)
+			{
+				if (!sub)
+					sub = ch->create_sub (y >> 4);
+				nib_set (sub->blight, i, nl);
+				ch->relit = true;
+				
+				this->enqueue_bl_local (job, x + 1, y, z);
+				this->enqueue_bl_local (job, x - 1, y, z);
+				this->enqueue_bl_local (job, x, y + 1, z);
+				this->enqueue_bl_local (job, x, y - 1, z);
+				this->enqueue_bl_local (job, x, y, z + 1);
+				this->enqueue_bl_local (job, x, y, z - 1);
+			}
+	}
+	
+	
+	
+	/* 
+	 * Handles the updates queued in a job's chunk, until its budget runs out.
+	 */
+	void
+	lighting_manager::run_job (light_job& job)
+	{
+		light_chunk *lc = job.lc;
+		int updated = 0;
+		
+		// sky light updates
+		while (!lc->sl.empty () && (updated < job.budget))
+			{
+				this->update_sky_light (job, lc->sl.pop ());
+				++ job.sl_done;
+				++ updated;
+			}
+		
+		// block light updates
+		while (!lc->bl.empty () && (updated < job.budget))
+			{
+				this->update_block_light (job, lc->bl.pop ());
+				++ job.bl_done;
+				++ updated;
+			}
+	}
+	
+	/* 
+	 * Runs the given jobs in parallel, and waits for all of them to finish.
+	 * No two jobs may operate on adjacent chunks.
+	 */
+	void
+	lighting_manager::run_jobs (std::vector<light_job *>& jobs)
+	{
+		if (!this->pool || (jobs.size () == 1))
+			{
+				for (light_job *job : jobs)
+					this->run_job (*job);
+				return;
+			}
+		
+		std::mutex done_lock;
+		std::condition_variable done_cv;
+		int remaining = jobs.size () - 1;
+		
+		for (size_t i = 1; i < jobs.size (); ++i)
+			this->pool->enqueue (
+				[this, &done_lock, &done_cv, &remaining] (void *ctx)
+					{
+						this->run_job (*static_cast<light_job *> (ctx));
+						
+						std::lock_guard<std::mutex> guard {done_lock};
+						if (-- remaining == 0)
+							done_cv.notify_one ();
+					}, jobs[i]);
+		
+		// the calling thread takes part as well.
+		this->run_job (*jobs[0]);
+		
+		std::unique_lock<std::mutex> guard {done_lock};
+		done_cv.wait (guard, [&remaining] { return remaining == 0; });
+	}
+	
+	
+	/* 
+	 * Recomputes block light in the specified chunk from scratch.
+	 */
+	void
+	lighting_manager::relight_block_light (chunk *ch, int cx, int cz)
+	{
+		light_chunk lc (cx, cz);
+		light_job job (&lc, ch);
+		job.budget = 0x7FFFFFFF;
+		
+		for (int sy = 0; sy < 16; ++sy)
+			{
+				subchunk *sub = ch->get_sub (sy);
+				if (!sub)
+					continue;
+				
+				std::memset (sub->blight, 0, sizeof sub->blight);
+				for (unsigned int i = 0; i < 4096; ++i)
+					{
+						unsigned short index = (sy << 12) | i;
+						int x = i & 0xF, z = (i >> 4) & 0xF;
+						if (block_info::from_id (sub_id (sub, i))->luminance > 0)
+							lc.bl.push (index);
+						else if (x == 0 || x == 15 || z == 0 || z == 15)
+							lc.bl.push (index); // might be lit by a neighbouring chunk
+					}
+			}
+		
+		// light that leaks out of the chunk is discarded, neighbouring chunks are
+		// relit on their own if they're dirty as well.
+		this->run_job (job);
+	}
+	
+	/* 
+	 * Returns the height of the given column, which may lie in a neighbouring
+	 * chunk (if it isn't loaded, the column of @{ch} closest to it is used).
+	 */
+	static inline int
+	column_height (chunk *ch, int x, int z)
+	{
+		int ox = x, oz = z; // rewritten by resolve_neighbour ()
+		chunk *nch = resolve_neighbour (ch, x, z);
+		if (!nch)
+			return ch->get_height (_min (_max (ox, 0), 15), _min (_max (oz, 0), 15));
+		return nch->get_height (x, z);
+	}
+	
+	/* 
+	 * Resets the light values of a single marked subchunk, and queues the
+	 * updates needed to settle them. @{batch} holds the subchunk masks of
+	 * all chunks relit along with it.
+	 */
+	void
+	lighting_manager::relight_subchunk (chunk *ch, int cx, int sy, int cz,
+		const std::unordered_map<unsigned long long, unsigned short>& batch)
+	{
+		int bx = cx << 4, by = sy << 4, bz = cz << 4;
+		
+		subchunk *sub = ch->get_sub (sy);
+		if (sub)
+			{
+				// start off with direct sky light and light sources only.
+				for (unsigned int i = 0; i < 4096; ++i)
+					{
+						int x = i & 0xF, z = (i >> 4) & 0xF, y = by | (i >> 8);
+						block_info *inf = block_info::from_id (sub_id (sub, i));
+						
+						int sl = 0;
+						if ((inf->opacity < 15) && ((y + 1) >= ch->get_height (x, z)))
+							sl = 15 - inf->opacity;
+						nib_set (sub->slight, i, sl);
+						nib_set (sub->blight, i, _min (inf->luminance, 15));
+						
+						if (inf->luminance > 0)
+							this->enqueue_bl_nolock (bx | x, y, bz | z);
+					}
+				
+				// sky light spreads sideways and downwards from where the heightmap
+				// changes.
+				for (int x = 0; x < 16; ++x)
+					for (int z = 0; z < 16; ++z)
+						{
+							int h  = ch->get_height (x, z);
+							int lo = _min (h, _min (column_height (ch, x + 1, z),
+								_min (column_height (ch, x - 1, z),
+								_min (column_height (ch, x, z + 1), column_height (ch, x, z - 1))))) - 1;
+							int hi = _max (h, _max (column_height (ch, x + 1, z),
+								_max (column_height (ch, x - 1, z),
+								_max (column_height (ch, x, z + 1), column_height (ch, x, z - 1)))));
+							
+							for (int y = _max (lo, by); y <= _min (hi, by + 15); ++y)
+								this->enqueue_sl_nolock (bx | x, y, bz | z);
+						}
+				
+				ch->relit = true;
+			}
+		
+		// light enters and leaves the region through its faces. faces shared
+		// with other subchunks that are relit along with this one are skipped.
+		auto marked = [&batch] (int ncx, int nsy, int ncz) -> bool
+			{
+				if (nsy < 0 || nsy > 15)
+					return false;
+				auto itr = batch.find (light_chunk_key (ncx, ncz));
+				return (itr != batch.end ()) && (itr->second & (1 << nsy));
+			};
+		bool seed_w = !marked (cx - 1, sy, cz), seed_e = !marked (cx + 1, sy, cz);
+		bool seed_d = !marked (cx, sy - 1, cz), seed_u = !marked (cx, sy + 1, cz);
+		bool seed_n = !marked (cx, sy, cz - 1), seed_s = !marked (cx, sy, cz + 1);
+		for (int a = 0; a < 16; ++a)
+			for (int b = 0; b < 16; ++b)
+				{
+					if (seed_w)
+						{ this->enqueue_nolock (bx - 1, by + a, bz + b);
+							this->enqueue_nolock (bx, by + a, bz + b); }
+					if (seed_e)
+						{ this->enqueue_nolock (bx + 16, by + a, bz + b);
+							this->enqueue_nolock (bx + 15, by + a, bz + b); }
+					if (seed_d)
+						{ this->enqueue_nolock (bx + a, by - 1, bz + b);
+							this->enqueue_nolock (bx + a, by, bz + b); }
+					if (seed_u)
+						{ this->enqueue_nolock (bx + a, by + 16, bz + b);
+							this->enqueue_nolock (bx + a, by + 15, bz + b); }
+					if (seed_n)
+						{ this->enqueue_nolock (bx + a, by + b, bz - 1);
+							this->enqueue_nolock (bx + a, by + b, bz); }
+					if (seed_s)
+						{ this->enqueue_nolock (bx + a, by + b, bz + 16);
+							this->enqueue_nolock (bx + a, by + b, bz + 15); }
+				}
+	}
+	
+	/* 
+	 * Relights marked subchunks, about @{max_cost} blocks' worth (at least
+	 * one chunk's worth). Returns the number of subchunks relit.
+	 */
+	int
+	lighting_manager::relight_regions (int max_cost)
+	{
+		// take a batch of chunks first, so that faces between subchunks relit
+		// together can be told apart from the region's boundary.
+		std::unordered_map<unsigned long long, unsigned short> batch;
+		std::vector<std::pair<int, int>> order;
+		int cost = 0;
+		while (!this->region_order.empty () && (order.empty () || cost < max_cost))
+			{
+				std::pair<int, int> pos = this->region_order.front ();
+				this->region_order.pop_front ();
+				
+				unsigned long long key = light_chunk_key (pos.first, pos.second);
+				auto itr = this->regions.find (key);
+				unsigned short mask = itr->second;
+				this->regions.erase (itr);
+				
+				batch[key] = mask;
+				order.push_back (pos);
+				for (int sy = 0; sy < 16; ++sy)
+					if (mask & (1 << sy))
+						cost += 4096;
+			}
+		
+		int relit = 0;
+		for (auto& pos : order)
+			{
+				chunk *ch = this->wr->get_chunk (pos.first, pos.second);
+				if (!ch)
+					continue;
+				
+				unsigned short mask = batch[light_chunk_key (pos.first, pos.second)];
+				for (int sy = 0; sy < 16; ++sy)
+					if (mask & (1 << sy))
+						{
+							this->relight_subchunk (ch, pos.first, sy, pos.second, batch);
+							++ relit;
+						}
+			}
+		
+		return relit;
+	}
+	
+	
+	/* 
+	 * Relights no more than @{max_chunks} dirty chunks.
+	 * Returns the number of chunks relit.
+	 */
+	int
+	lighting_manager::relight_dirty (int max_chunks)
 	{
-		lighting_manager *lm = static_cast<lighting_manager *> (param);
-		lm->enqueue_bl_nolock (x, y, z);
+		int relit = 0;
+		while (!this->dirty.empty () && (relit < max_chunks))
+			{
+				std::pair<int, int> pos = this->dirty.front ();
+				this->dirty.pop_front ();
+				this->dirty_set.erase (light_chunk_key (pos.first, pos.second));
+				
+				chunk *ch = this->wr->get_chunk (pos.first, pos.second);
+				if (!ch)
+					continue;
+				
+				this->relight_chunk (ch);
+				this->relight_block_light (ch, pos.first, pos.second);
+				ch->relit = true;
+				
+				++ relit;
+				++ this->relit_count;
+			}
+		
+		return relit;
 	}
 	
+	
+	
 	/* 
 	 * Goes through all queued updates and handles them (No more than
 	 * @{max_updates} updates are handled).
 	 * 
-	 * Returns the total amount of updates handled.
+	 * Returns the total amount of updates handled. If @{pending} is non-null,
+	 * the number of updates still queued is stored in it (or, in degraded
+	 * mode, the number of chunks still waiting to be relit).
 	 */
 	int
-	lighting_manager::update (int max_updates)
+	lighting_manager::update (int max_updates, int *pending)
 	{
+		const static int min_job_updates = 64;
+		const static int relight_cost    = 4096; // in updates
 		std::lock_guard<std::mutex> guard {this->lock};
 		
-		int updated = 0;
-		
-		// sky light updates
-		while (!this->sl_updates.empty () && (updated++ < max_updates))
+		if (this->degraded)
 			{
-				light_update u = this->sl_updates.front ();
-				this->sl_updates.pop ();
+				if (!this->active.empty ())
+					this->collapse_queues ();
 				
-				calc_sky_light (*this, u.x, u.y, u.z, lm_enqueue_sl, this);
+				int relit = this->relight_dirty (_max (1, max_updates / relight_cost));
+				if (this->dirty.empty ())
+					{
+						this->degraded = false;
+						this->log (LT_INFO) << "World \"" << this->wr->get_name () <<
+							"\": Lighting caught up, resuming normal operation" << std::endl;
+					}
+				
+				if (pending)
+					*pending = (int)this->dirty.size ();
+				return relit;
 			}
-		if (this->sl_updates.empty ())
-			this->sl_overloaded = false;
 		
-		// block light updates
-		updated = 0;
-		while (!this->bl_updates.empty () && (updated++ < max_updates))
+		if (!this->region_order.empty ())
+			this->relight_regions (max_updates);
+		
+		std::vector<light_job> jobs;
+		jobs.reserve (this->active.size ());
+		for (light_chunk *lc : this->active)
+			{
+				chunk *ch = this->wr->get_chunk (lc->cx, lc->cz);
+				if (ch)
+					jobs.emplace_back (lc, ch);
+				else
+					{
+						// the chunk is not loaded, there's nothing to light.
+						this->adjust_pending (- lc->sl.size (), - lc->bl.size ());
+						this->chunks.erase (light_chunk_key (lc->cx, lc->cz));
+						delete lc;
+					}
+			}
+		this->active.clear ();
+		
+		int updated = 0;
+		if (!jobs.empty ())
 			{
-				light_update u = this->bl_updates.front ();
-				this->bl_updates.pop ();
+				int budget = max_updates / (int)jobs.size ();
+				if (budget < min_job_updates)
+					budget = min_job_updates;
+				
+				// group chunks by the parity of their coordinates.
+				std::vector<light_job *> passes[4];
+				for (light_job& job : jobs)
+					{
+						job.budget = budget;
+						passes[((job.lc->cx & 1) << 1) | (job.lc->cz & 1)].push_back (&job);
+					}
 				
-				calc_block_light (*this, u.x, u.y, u.z, lm_enqueue_bl, this);
+				for (int p = 0; (p < 4) && (updated < max_updates); ++p)
+					{
+						if (passes[p].empty ())
+							continue;
+						
+						this->run_jobs (passes[p]);
+						
+						// propagate updates across chunk boundaries.
+						for (light_job *job : passes[p])
+							{
+								updated += job->sl_done + job->bl_done;
+								this->adjust_pending (job->sl_added - job->sl_done,
+									job->bl_added - job->bl_done);
+								
+								for (light_update& u : job->sl_out)
+									this->enqueue_sl_nolock (u.x, u.y, u.z);
+								for (light_update& u : job->bl_out)
+									this->enqueue_bl_nolock (u.x, u.y, u.z);
+							}
+					}
+				
+				for (light_job& job : jobs)
+					{
+						light_chunk *lc = job.lc;
+						if (lc->sl.empty () && lc->bl.empty ())
+							{
+								this->chunks.erase (light_chunk_key (lc->cx, lc->cz));
+								delete lc;
+							}
+						else
+							this->active.push_back (lc);
+					}
 			}
-		if (this->bl_updates.empty ())
-			this->bl_overloaded = false;
 		
+		if (this->degraded)
+			{
+				this->collapse_queues ();
+				if (pending)
+					*pending = (int)this->dirty.size ();
+				return updated;
+			}
+		
+		if (pending)
+			*pending = this->sl_pending + this->bl_pending;
 		return updated;
 	}
 }
-
@@ -69,6 +69,14 @@ namespace hCraft {
 		{
 			w.queue_physics_once (x, y, z, 0, nullptr, this->tick_rate ());
 		}
+		
+		bool
+		sand::is_active (unsigned char meta, const blocki nb[6])
+		{
+			// sand falls into air below it, or slides off to a side that's open.
+			return (nb[2].id == BT_AIR) || (nb[0].id == BT_AIR) || (nb[1].id == BT_AIR)
+				|| (nb[4].id == BT_AIR) || (nb[5].id == BT_AIR);
+		}
 	}
 }
 
@@ -42,6 +42,13 @@ namespace hCraft {
 			return false;
 		}
 		
+		// whether water placed in bulk can spread into the given block.
+		static bool
+		can_flow_into (const blocki& bl)
+		{
+			return (bl.id != BT_WATER) && !block_info::from_id (bl.id)->opaque;
+		}
+		
 		void
 		water::tick (world &w, int x, int y, int z, int extra, void *ptr)
 		{
@@ -68,6 +75,28 @@ namespace hCraft {
 						w.queue_update (x, y, z - 1, BT_WATER, next_lv);
 				}
 		}
+		
+		void
+		water::on_neighbour_modified (world &w, int x, int y, int z,
+			int nx, int ny, int nz)
+		{
+			// water left inactive by a bulk commit may now be able to flow.
+			w.queue_physics_once (x, y, z, 0, nullptr, this->tick_rate ());
+		}
+		
+		bool
+		water::is_active (unsigned char meta, const blocki nb[6])
+		{
+			if (can_flow_into (nb[2]))
+				return true;
+			
+			unsigned char lv = meta;
+			if (lv > 8)
+				lv = 0;
+			if ((lv & 7) == 7)
+				return false;
+			return can_flow_into (nb[0]) || can_flow_into (nb[1])
+				|| can_flow_into (nb[4]) || can_flow_into (nb[5]);
+		}
 	}
 }
-
@@ -35,6 +35,8 @@ namespace hCraft {
 			data (item)
 	{
 		this->valid = true;
+		this->merged = false;
+		this->sys_index = -1;
 	}
 	
 	
@@ -71,73 +73,87 @@ namespace hCraft {
 	
 	
 	
-	/* 
-	 * Half a second should pass after a pickup item spawns before it could be
-	 * collected by a player. This method checks if enough time has passed.
-	 */
 	bool
-	pickup_item::pickable ()
+	pickup_item::can_merge_with (pickup_item *other)
 	{
-		return ((std::chrono::steady_clock::now () - this->spawn_time)
-			>= std::chrono::milliseconds (500));
+		if (other == this || !other->valid || other->merged)
+			return false;
+		
+		// only plain items are merged, so that nothing is lost.
+		const slot_item& a = this->data, &b = other->data;
+		if (!a.enchants.empty () || !b.enchants.empty () ||
+			!a.display_name.empty () || !b.display_name.empty () ||
+			!a.lore.empty () || !b.lore.empty ())
+			return false;
+		
+		return this->data.compatible_with (other->data) &&
+			((a.amount () + b.amount ()) <= a.max_stack ());
 	}
 	
-	
-	static double
-	calc_distance_squared (entity_pos origin, entity_pos other)
-	{
-		double dx = other.x - origin.x;
-		double dy = other.y - origin.y;
-		double dz = other.z - origin.z;
-		return dx*dx + dy*dy + dz*dz;
-	}
-
 	/* 
-	 * Called by the world that's holding the entity every tick (50ms).
-	 * A return value of true will cause the world to destroy the entity.
+	 * Absorbs compatible items lying close to this one, as long as the
+	 * combined stack fits.
 	 */
-	bool
-	pickup_item::tick (world &w)
+	void
+	pickup_item::merge_nearby (world &w)
 	{
-		if (!valid)
-			return false;
+		const static double merge_radius = 1.0;
+		
+		if (this->data.full ())
+			return;
 		
-		// fall if possible
-		if (w.get_id ((int)this->pos.x, (int)(this->pos.y - 0.1), (int)this->pos.z)
-			== BT_AIR) // TODO: fall through any transparent block
+		std::vector<entity *> found;
+		pickup_item *me = this;
+		w.get_entity_grid ().nearest (this->pos, 8, merge_radius, found,
+			[me] (entity *e)
+				{
+					return (e->get_type () == ET_ITEM)
+						&& me->can_merge_with (static_cast<pickup_item *> (e));
+				});
+		
+		bool changed = false;
+		for (entity *e : found)
 			{
-				this->pos.y -= 0.1;
+				pickup_item *other = static_cast<pickup_item *> (e);
+				if (!this->can_merge_with (other))
+					continue; // no longer fits
+				
+				this->data.give (other->data.amount ());
+				other->data.set_amount (0);
+				other->merged = true; // despawned on its next tick
+				changed = true;
 			}
 		
-		if (!pickable ())
-			return false;
-		
+		if (changed)
+			{
+				// let viewers know about the new stack size
+				entity_metadata dict;
+				this->build_metadata (dict);
+				w.send_to_viewers (this->pos, packet::make_entity_metadata (this->eid, dict));
+			}
+	}
+	
+	
+	
+	/* 
+	 * Gives the item to the closest player in range, if there is one.
+	 * Returns true if nothing is left of the item.
+	 */
+	bool
+	pickup_item::try_pickup (world &w)
+	{
 		// fetch closest player
-		std::pair<player *, double> closest;
-		int i = 0;
-		pickup_item *me = this;
-		w.get_players ().all (
-			[&i, me, &closest] (player *pl)
+		std::vector<entity *> found;
+		w.get_entity_grid ().nearest (this->pos, 1, 1.5, found,
+			[] (entity *e)
 				{
-					if (pl->is_dead ())
-						return;
-					
-					double dist = calc_distance_squared (me->pos, pl->pos);
-					if (i == 0)
-						closest = {pl, dist};
-					else
-						{
-							if (dist < closest.second)
-								closest = {pl, dist};
-						}
-					++ i;
+					return (e->get_type () == ET_PLAYER)
+						&& !static_cast<player *> (e)->is_dead ();
 				});
-		
-		if ((i == 0) || (closest.second > 2.25))
+		if (found.empty ())
 			return false;
 		
-		player *pl = closest.first;
-		if (!pl) return false;
+		player *pl = static_cast<player *> (found[0]);
 		
 		int r = pl->inv.add (this->data);
 		if (r < this->data.amount ())
@@ -155,5 +171,18 @@ namespace hCraft {
 			}
 		return false;
 	}
+	
+	
+	
+	/* 
+	 * Called by the world that's holding the entity every tick (50ms).
+	 * A return value of true will cause the world to destroy the entity.
+	 */
+	bool
+	pickup_item::tick (world &w)
+	{
+		// everything else is done by the world's item_system.
+		return this->expired ();
+	}
 }
 
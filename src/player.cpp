@@ -23,6 +23,7 @@
 #include "commands/command.hpp"
 #include "utils.hpp"
 #include "sql.hpp"
+#include "sqlops.hpp"
 #include "pickup.hpp"
 
 #include <memory>
@@ -43,13 +44,22 @@
 
 namespace hCraft {
 	
+	// output queue limits (in bytes).
+	static const unsigned int out_low_watermark  = 256 * 1024;
+	static const unsigned int out_high_watermark = 1024 * 1024;
+	static const unsigned int out_hard_limit     = 8 * 1024 * 1024;
+	static const std::chrono::seconds out_hard_limit_grace (10);
+	
+	
+	
 	/* 
 	 * Constructs a new player around the given socket.
 	 */
 	player::player (server &srv, struct event_base *evbase, evutil_socket_t sock,
 		const char *ip)
 		: entity (srv.next_entity_id ()),
-			srv (srv), log (srv.get_logger ()), sock (sock)
+			srv (srv), log (srv.get_logger ()), sock (sock),
+			known_chunks (srv.get_config ().max_view_dist)
 	{
 		std::strcpy (this->ip, ip);
 		
@@ -72,6 +82,12 @@ namespace hCraft {
 		this->reading = false;
 		this->writing = false;
 		this->handlers_scheduled = 0;
+		this->out_bytes = 0;
+		this->out_pressured = false;
+		this->stream_paused = false;
+		this->movement_stale = false;
+		this->queued_time = nullptr;
+		this->over_limit = false;
 		this->total_read = 0;
 		this->read_rem = 1;
 		
@@ -88,6 +104,10 @@ namespace hCraft {
 		
 		this->curr_world = nullptr;
 		this->curr_chunk = chunk_pos (0, 0);
+		this->view_min = srv.get_config ().min_view_dist;
+		this->view_max = srv.get_config ().max_view_dist;
+		this->view_dist = srv.get_config ().max_view_dist;
+		this->view_calm = 0;
 		this->ping_waiting = false;
 		this->sb_block.set (BT_GLASS);
 		
@@ -290,8 +310,14 @@ namespace hCraft {
 				packet *pack = pl->out_queue.front ();
 				pl->out_queue.pop ();
 				opcode = pack->data[0];
+				pl->out_bytes -= pack->size;
 				delete pack;
 				
+				if (pl->out_pressured && (pl->out_bytes < out_low_watermark))
+					pl->out_pressured = false;
+				if (pl->out_bytes <= out_hard_limit)
+					pl->over_limit = false;
+				
 				if (pl->kicked && (opcode == 0xFF))
 					{
 						if (pl->kick_msg[0] == '\0')
@@ -305,6 +331,8 @@ namespace hCraft {
 								delete pack;
 								pl->out_queue.pop ();
 							}
+						pl->out_bytes = 0;
+						pl->queued_time = nullptr;
 						
 						pl->writing = false;
 						pl->disconnect (true);
@@ -315,6 +343,8 @@ namespace hCraft {
 				if (!pl->out_queue.empty ())
 					{
 						packet *pack = pl->out_queue.front ();
+						if (pack == pl->queued_time)
+							pl->queued_time = nullptr; // can't be changed anymore
 						bufferevent_write (bufev, pack->data, pack->size);
 					}
 			}
@@ -365,6 +395,8 @@ namespace hCraft {
 		if (this->curr_world)
 			{
 				this->curr_world->get_players ().remove (this);
+				this->curr_world->get_interest ().remove (this);
+				this->curr_world->get_entity_grid ().remove (this);
 				
 				if (!this->get_server ().is_shutting_down ())
 					{
@@ -453,7 +485,31 @@ namespace hCraft {
 			{ delete pack; return; }
 		
 		std::lock_guard<std::mutex> guard {this->out_lock};
+		
+		// time updates are absolute, so one that is still waiting in the queue
+		// can simply be overwritten by a newer one.
+		if (pack->data[0] == 0x04)
+			{
+				if (this->queued_time && (this->queued_time->size == pack->size))
+					{
+						std::memcpy (this->queued_time->data, pack->data, pack->size);
+						delete pack;
+						return;
+					}
+				if (!this->out_queue.empty ())
+					this->queued_time = pack;
+			}
+		
 		this->out_queue.push (pack);
+		this->out_bytes += pack->size;
+		if (this->out_bytes > out_high_watermark)
+			this->out_pressured = true;
+		if ((this->out_bytes > out_hard_limit) && !this->over_limit)
+			{
+				this->over_limit = true;
+				this->over_limit_since = std::chrono::steady_clock::now ();
+			}
+		
 		if (this->out_queue.size () == 1)
 			{
 				// initiate write
@@ -517,6 +573,7 @@ namespace hCraft {
 				// despawn self from other players (and vice-versa).
 				player *me = this;
 				this->curr_world->get_players ().remove (this);
+				this->curr_world->get_entity_grid ().remove (this);
 				this->curr_world->get_players ().all (
 					[me] (player *pl)
 						{
@@ -526,6 +583,7 @@ namespace hCraft {
 									pl->despawn_from (me);
 								}
 						});
+				this->curr_world->get_interest ().remove (this);
 				
 				// despawn from entities
 				this->curr_world->all_entities (
@@ -540,9 +598,12 @@ namespace hCraft {
 		
 		this->curr_world = w;
 		this->pos = destpos;
+		this->tracker.reset ();
 		this->curr_world->get_players ().add (this);
+		this->curr_world->get_entity_grid ().insert (this);
 		
 		this->last_ground_height = -128.0;
+		this->refresh_view_bounds ();
 		this->stream_chunks ();
 		
 		entity_pos epos = this->pos;
@@ -590,39 +651,33 @@ namespace hCraft {
 	 * far away.
 	 */
 	void
-	player::stream_chunks (int radius)
+	player::stream_chunks ()
 	{
 		world &wr = *this->get_world ();
 		std::lock_guard<std::mutex> wguard {this->world_lock};
-		std::multiset<chunk_pos, chunk_pos_less> to_load {chunk_pos_less (this->pos)};
-		auto prev_chunks = this->known_chunks;
+		std::vector<chunk_pos>& to_load = this->stream_load;
+		std::vector<chunk_pos>& prev_chunks = this->stream_drop;
+		to_load.clear ();
+		prev_chunks.clear ();
 		
 		chunk_pos center = this->pos;
-		int r_half = radius / 2;
-		for (int cx = (center.x - r_half); cx <= (center.x + r_half); ++cx)
-			for (int cz = (center.z - r_half); cz <= (center.z + r_half); ++cz)
-				{
-					chunk_pos cpos = chunk_pos (cx, cz);
-					if (this->known_chunks.count (cpos) == 0)
-						{
-							to_load.insert (cpos);
-						}
-					prev_chunks.erase (cpos);
-				}
+		int radius = this->view_distance ();
+		this->known_chunks.recenter (center, radius, prev_chunks, to_load);
+		std::sort (to_load.begin (), to_load.end (), chunk_pos_less (this->pos));
+		
+		// hold new chunks back while the client can't keep up, they are sent
+		// once the output queue drains (see check_output ()).
+		this->stream_paused = this->output_pressured () && !to_load.empty ();
+		if (this->stream_paused)
+			to_load.clear ();
 		
 		for (auto cpos : to_load)
 			{
-				// make sure all 4 adjacent & 4 corner chunks are already loaded
-				// this is done to prevent incompletely-generated chunks to be sent
-				// to the player.
-				for (int x = cpos.x - 1; x <= cpos.x + 1; ++x)
-					for (int z = cpos.z - 1; z <= cpos.z + 1; ++z)
-						if (!(x == cpos.x && z == cpos.z)) 
-							wr.load_chunk (x, z);
-							
-					
-				this->known_chunks.insert (cpos);
-				chunk *ch = wr.load_chunk (cpos.x, cpos.z);
+				// only ready chunks are sent, to prevent incompletely-generated chunks
+				// from being sent to the player.
+				this->known_chunks.insert (cpos.x, cpos.z);
+				wr.get_interest ().add (this, cpos.x, cpos.z);
+				chunk *ch = wr.load_chunk (cpos.x, cpos.z, CS_READY);
 				this->send (packet::make_chunk (cpos.x, cpos.z, ch));
 				
 				// send any selection blocks from that chunk
@@ -649,7 +704,7 @@ namespace hCraft {
 		
 		for (auto cpos : prev_chunks)
 			{
-				this->known_chunks.erase (cpos);
+				wr.get_interest ().remove (this, cpos.x, cpos.z);
 				this->send (packet::make_empty_chunk (cpos.x, cpos.z));
 				
 				// despawn self from other players and vice-versa.
@@ -685,7 +740,7 @@ namespace hCraft {
 	 * unloading them first.
 	 */
 	void
-	player::stream_common_chunks (world *wr, entity_pos dest_pos, int radius)
+	player::stream_common_chunks (world *wr, entity_pos dest_pos)
 	{
 		std::lock_guard<std::mutex> wguard {this->world_lock};
 		
@@ -696,32 +751,22 @@ namespace hCraft {
 		if (prev_chunk)
 			prev_chunk->remove_entity (this);
 		
-		std::multiset<chunk_pos, chunk_pos_less> to_load {chunk_pos_less (spawn_pos)};
-		int r_half = radius / 2;
-		for (int cx = (center.x - r_half); cx <= (center.x + r_half); ++cx)
-			for (int cz = (center.z - r_half); cz <= (center.z + r_half); ++cz)
-				{
-					chunk_pos cpos = chunk_pos (cx, cz);
-					to_load.insert (cpos);
-				}
-		
 		// keep chunks that are shared between both worlds, remove others.
-		for (auto itr = to_load.begin (); itr != to_load.end (); )
-			{
-				chunk_pos cpos = *itr;
-				if (std::find (this->known_chunks.begin (), this->known_chunks.end (),
-					cpos) == this->known_chunks.end ())
-					{
-						// not contained by both worlds, remove.
-						itr = to_load.erase (itr);
-					}
-				else
-					++ itr;
-			}
+		std::vector<chunk_pos>& to_load = this->stream_load;
+		std::vector<chunk_pos>& to_unload = this->stream_drop;
+		to_unload.clear ();
+		this->known_chunks.recenter (center, this->view_distance (), to_unload,
+			to_load);
+		to_load.clear (); // only chunks known from before are resent
+		this->known_chunks.for_each (
+			[&to_load] (chunk_pos cpos)
+				{ to_load.push_back (cpos); });
+		std::sort (to_load.begin (), to_load.end (), chunk_pos_less (spawn_pos));
 		
 		for (auto cpos : to_load)
 			{
-				chunk *ch = wr->load_chunk (cpos.x, cpos.z);
+				wr->get_interest ().add (this, cpos.x, cpos.z);
+				chunk *ch = wr->load_chunk (cpos.x, cpos.z, CS_READY);
 				this->send (packet::make_chunk (cpos.x, cpos.z, ch));
 				
 				this->sb_updates.preview_chunk_to (this, cpos.x, cpos.z, false);
@@ -758,38 +803,24 @@ namespace hCraft {
 			}
 		
 		// unload all other chunks
-		for (auto itr = this->known_chunks.begin (); itr != this->known_chunks.end (); )
-			{
-				chunk_pos cpos = *itr;
-				if (std::find (to_load.begin (), to_load.end (), cpos) == to_load.end ())
-					{
-						this->send (packet::make_empty_chunk (cpos.x, cpos.z));
-						itr = this->known_chunks.erase (itr);
-					}
-				else
-					++ itr;
-			}
+		for (auto cpos : to_unload)
+			this->send (packet::make_empty_chunk (cpos.x, cpos.z));
 		
 		to_load.clear ();
+		to_unload.clear ();
 	}
 	
 	/* 
-	 * Checks whether the specified chunk is within the visible chunk range
-	 * of the player.
+	 * Checks whether the specified chunk has been sent to the player (and is
+	 * still loaded on its side), i.e. whether changes made to it are visible.
 	 */
 	bool
 	player::can_see_chunk (int x, int z)
 	{
-	/*
-		std::unique_lock<std::mutex> guard {this->world_lock};
-		auto itr = this->known_chunks.find (chunk_pos (x, z));
-		return (itr != this->known_chunks.end ());*/
-		
-		chunk_pos me_pos = this->pos;
-		chunk_pos ch_pos = {x, z};
-		return (
-			(utils::iabs (me_pos.x - ch_pos.x) <= player::chunk_radius ()) &&
-			(utils::iabs (me_pos.z - ch_pos.z) <= player::chunk_radius ()));
+		// chunks that are in range, but weren't sent yet (e.g. while streaming
+		// is paused), are not visible.
+		world *w = this->curr_world;
+		return w && w->get_interest ().is_viewer (this, x, z);
 	}
 	
 	
@@ -837,6 +868,7 @@ namespace hCraft {
 		
 		entity_pos prev_pos = this->pos;
 		this->pos = dest;
+		this->get_world ()->get_entity_grid ().move (this);
 		
 		chunk_pos curr_cpos = dest;
 		chunk_pos prev_cpos = prev_pos;
@@ -851,8 +883,6 @@ namespace hCraft {
 		double x_delta = dest.x - prev_pos.x;
 		double y_delta = dest.y - prev_pos.y;
 		double z_delta = dest.z - prev_pos.z;
-		float r_delta = dest.r - prev_pos.r;
-		float l_delta = dest.l - prev_pos.l;
 		
 	//----
 		/* 
@@ -876,39 +906,8 @@ namespace hCraft {
 	//----
 		
 		
-		if (x_delta == 0.0 && y_delta == 0.0 && z_delta == 0.0)
-			{
-				// position hasn't changed.
-				
-				if (r_delta == 0.0f && l_delta == 0.0f)
-					{
-						// the player hasn't moved at all.
-						
-					}
-				else
-					{
-						// only orientation changed.
-						std::lock_guard<std::mutex> guard {this->visible_player_lock};
-						for (player *pl : this->visible_players)
-							{
-								pl->send (packet::make_entity_look (this->get_eid (), dest.r, dest.l));
-								pl->send (packet::make_entity_head_look (this->get_eid (), dest.r));
-							}
-					}
-			}
-		else
-			{
-				// position has changed.
-				
-				std::lock_guard<std::mutex> guard {this->visible_player_lock};
-				for (player *pl : this->visible_players)
-					{
-						pl->send (packet::make_entity_teleport (this->get_eid (),
-							std::round (dest.x * 32.0), std::round (dest.y * 32.0),
-							std::round (dest.z * 32.0), dest.r, dest.l));
-						pl->send (packet::make_entity_head_look (this->get_eid (), dest.r));
-					}
-			}
+		// NOTE: the new position is broadcast to other players by the world, once
+		//       per tick (see send_movement_updates ()).
 		
 		this->handle_falls_and_jumps (prev_pos.on_ground, this->pos.on_ground, prev_pos);
 	}
@@ -926,16 +925,153 @@ namespace hCraft {
 	
 	/* 
 	 * Checks whether this player can be seen by player @{pl}.
+	 * NOTE: Both players must have been sent each other's chunks, to keep the
+	 *       relation symmetric.
 	 */
 	bool
 	player::visible_to (player *pl)
 	{
 		chunk_pos me_pos = this->pos;
 		chunk_pos pl_pos = pl->pos;
+		return pl->can_see_chunk (me_pos.x, me_pos.z)
+			&& this->can_see_chunk (pl_pos.x, pl_pos.z);
+	}
+	
+	
+	
+	/* 
+	 * Recomputes the bounds of the player's view distance from the server's
+	 * configuration and the player's rank, clamping the current view
+	 * distance to them. Returns true if the view distance changed.
+	 */
+	bool
+	player::refresh_view_bounds ()
+	{
+		const server_config& cfg = this->get_server ().get_config ();
+		int max = cfg.max_view_dist;
 		
-		return (
-			(utils::iabs (me_pos.x - pl_pos.x) <= player::chunk_radius ()) &&
-			(utils::iabs (me_pos.z - pl_pos.z) <= player::chunk_radius ()));
+		int rank_max = this->rnk.view_distance ();
+		if (rank_max > 0 && rank_max < max)
+			max = rank_max;
+		int min = std::min (cfg.min_view_dist, max);
+		this->view_max = max;
+		this->view_min = min;
+		
+		// the world thread might be adjusting the distance at the same time.
+		int dist = this->view_dist.load ();
+		int next;
+		do
+			{
+				next = std::max (min, std::min (dist, max));
+				if (next == dist)
+					return false;
+			}
+		while (!this->view_dist.compare_exchange_weak (dist, next));
+		return true;
+	}
+	
+	/* 
+	 * Called by the player's world about once a second. Shrinks the view
+	 * distance by a chunk if the world is @{overloaded} or the player's
+	 * output queue is backed up, and grows it back after a few calm checks.
+	 */
+	void
+	player::adjust_view_distance (bool overloaded)
+	{
+		const static int calm_checks = 5;
+		
+		if (this->bad () || !this->curr_world)
+			return;
+		
+		unsigned int backlog;
+		{
+			std::lock_guard<std::mutex> guard {this->out_lock};
+			backlog = this->out_bytes;
+		}
+		
+		int dist = this->view_dist.load ();
+		int next = dist;
+		if (overloaded || this->output_pressured ())
+			{
+				this->view_calm = 0;
+				if (dist > this->view_min)
+					next = dist - 1;
+			}
+		else if (backlog < out_low_watermark)
+			{
+				if ((++ this->view_calm >= calm_checks) && (dist < this->view_max))
+					{
+						next = dist + 1;
+						this->view_calm = 0;
+					}
+			}
+		else
+			this->view_calm = 0;
+		
+		if (next == dist)
+			return;
+		
+		// don't override a new limit set by refresh_view_bounds () meanwhile.
+		if (!this->view_dist.compare_exchange_strong (dist, next))
+			return;
+		
+		this->schedule_stream ();
+	}
+	
+	/* 
+	 * Called by the player's world about once a second. Disconnects the
+	 * player if its output queue stayed over the hard limit for too long,
+	 * and resumes chunk streaming once the pressure is gone.
+	 * Returns false if the player got disconnected.
+	 */
+	bool
+	player::check_output ()
+	{
+		if (this->bad ())
+			return false;
+		
+		bool too_slow;
+		{
+			std::lock_guard<std::mutex> guard {this->out_lock};
+			too_slow = this->over_limit && ((std::chrono::steady_clock::now ()
+				- this->over_limit_since) >= out_hard_limit_grace);
+		}
+		if (too_slow)
+			{
+				log (LT_WARNING) << this->get_username ()
+					<< " could not keep up with the server's output, disconnecting." << std::endl;
+				this->disconnect (true);
+				return false;
+			}
+		
+		if (this->stream_paused && !this->output_pressured ())
+			{
+				this->stream_paused = false;
+				this->schedule_stream ();
+			}
+		return true;
+	}
+	
+	/* 
+	 * Re-runs chunk streaming on a pooled thread, the same way packet
+	 * handlers are run (and guarded against the player being destroyed).
+	 */
+	void
+	player::schedule_stream ()
+	{
+		++ this->handlers_scheduled;
+		this->get_server ().get_thread_pool ().enqueue (
+			[] (void *ctx)
+				{
+					player *pl = static_cast<player *> (ctx);
+					if (!pl->bad () && !pl->is_disconnecting ())
+						{
+							std::lock_guard<std::mutex> guard {pl->join_lock};
+							if (pl->curr_world)
+								pl->stream_chunks ();
+						}
+					-- pl->handlers_scheduled;
+				}, this);
 	}
 	
 	
@@ -1013,7 +1149,12 @@ namespace hCraft {
 		get_ping_name (this->get_rank ().main_group->color, this->get_username (),
 			ping_name);
 		
+		// the player must be spawned where the others were last told it is, since
+		// further movement is sent relative to that.
 		entity_pos me_pos = this->pos;
+		if (this->tracker.valid)
+			me_pos.set (this->tracker.x / 32.0, this->tracker.y / 32.0,
+				this->tracker.z / 32.0, this->tracker.r, this->tracker.l, me_pos.on_ground);
 		entity_metadata me_meta;
 		this->build_metadata (me_meta);
 		pl->send (packet::make_spawn_named_entity (
@@ -1033,6 +1174,55 @@ namespace hCraft {
 		}
 	}
 	
+	/* 
+	 * Sends the movement updates produced by the trackers of all visible
+	 * players during this tick to this player, as a single batch.
+	 */
+	void
+	player::send_movement_updates ()
+	{
+		std::lock_guard<std::mutex> guard {this->visible_player_lock};
+		
+		// movement updates are deltas, so dropped ones can't just be skipped.
+		// instead, once the pressure is gone, every visible player is teleported
+		// to where everybody else currently sees it.
+		if (this->output_pressured ())
+			{
+				this->movement_stale = true;
+				return;
+			}
+		else if (this->movement_stale)
+			{
+				this->movement_stale = false;
+				
+				packet *pack = new packet (32 * this->visible_players.size () + 1);
+				unsigned char buf[32];
+				for (player *pl : this->visible_players)
+					{
+						int len = pl->tracker.encode_state (pl->get_eid (), buf);
+						if (len > 0)
+							pack->put_bytes (buf, len);
+					}
+				if (pack->size > 0)
+					this->send (pack);
+				else
+					delete pack;
+				return;
+			}
+		
+		unsigned int total = 0;
+		for (player *pl : this->visible_players)
+			total += pl->tracker.out_len;
+		if (total == 0)
+			return;
+		
+		packet *pack = new packet (total);
+		for (player *pl : this->visible_players)
+			if (pl->tracker.out_len > 0)
+				pack->put_bytes (pl->tracker.out, pl->tracker.out_len);
+		this->send (pack);
+	}
+	
 	/* 
 	 * Despawns self from the specified player.
 	 */
@@ -1148,72 +1338,164 @@ namespace hCraft {
 	
 //----
 	
+	static unsigned int
+	elapsed_us (std::chrono::steady_clock::time_point& since)
+	{
+		std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now ();
+		unsigned int us = (unsigned int)std::chrono::duration_cast<
+			std::chrono::microseconds> (now - since).count ();
+		since = now;
+		return us;
+	}
+	
 	/* 
-	 * Loads information about the player from the server's SQL database.
+	 * Starts the login pipeline (see player.hpp). The player is kept alive
+	 * until it completes, the same way it is for packet handlers.
 	 */
 	void
-	player::load_data ()
+	player::begin_login ()
 	{
-		{
-			sql::row row;
-			auto& conn = this->get_server ().sql ().pop ();
-			
-			{
-				auto count_stmt = conn.query ("SELECT Count(*) FROM `players`");
-				if (count_stmt.step (row))
-					{
-						int pl_count = row.at (0).as_int ();
-						if (pl_count == 0)
-							{
-								this->message ("§4Congratulations§c!");
-								this->message ("§cYou are the first player to log in§7, §cand thus you have been");
-								this->message ("§cgiven the highest rank and have been granted §4operator §cstatus§7.");
-								
-								this->op = true;
-								this->rnk.set (("@" + this->get_server ().get_groups ().highest ()->name).c_str (),
-									this->get_server ().get_groups ());
-							}
-					}
-			}
-			
-			auto stmt = conn.query ("SELECT * FROM `players` WHERE `name`=?");
-			stmt.bind (1, this->get_username ());
-			
-			if (stmt.step (row))
+		this->login_stage_start = std::chrono::steady_clock::now ();
+		
+		++ this->handlers_scheduled;
+		this->get_server ().get_db_executor ().enqueue (
+			[] (void *ctx)
 				{
-					this->op = (row.at (2).as_int () == 1);
+					player *pl = static_cast<player *> (ctx);
+					server &srv = pl->get_server ();
+					
 					try
 						{
-							this->rnk.set (row.at (3).as_cstr (), this->get_server ().get_groups ());
+							if (!pl->bad () && !srv.is_shutting_down ())
+								{
+									pl->fetch_record ();
+									srv.record_login_stage (LS_LOOKUP,
+										elapsed_us (pl->login_stage_start));
+								}
 						}
-					catch (const std::exception& str)
+					catch (const std::exception& ex)
 						{
-							this->rnk.set (this->get_server ().get_groups ().default_rank);
-							this->log (LT_WARNING) << "Player \"" << this->get_username () << "\" has an invalid rank." << std::endl;
+							pl->log (LT_ERROR) << "Failed to load data of player "
+								<< pl->get_username () << ": " << ex.what () << std::endl;
+							pl->disconnect (false, false);
 						}
-					std::strcpy (this->nick, row.at (4).as_cstr ());
-				}
-			else
-				{
-					if (!this->op)
-						this->rnk.set (this->get_server ().get_groups ().default_rank);
 					
-					std::string grp_str;
-					this->rnk.get_string (grp_str);
-					
-					std::strcpy (this->nick, this->username);
-					
-					auto stmt = conn.query (
-						"INSERT INTO `players` (`name`, `op`, `groups`, `nick`) VALUES (?, ?, ?, ?)");
-					stmt.bind (1, this->get_username ());
-					stmt.bind (2, this->op ? 1 : 0);
-					stmt.bind (3, grp_str.c_str (), sql::pass_transient);
-					stmt.bind (4, this->get_nickname ());
-					stmt.execute ();
-				}
-			
-			this->get_server ().sql ().push (conn);
-		}
+					// continue on the thread pool, so that the database thread can move
+					// on to the next login.
+					srv.get_thread_pool ().enqueue (
+						[] (void *ctx)
+							{
+								player *pl = static_cast<player *> (ctx);
+								server &srv = pl->get_server ();
+								
+								try
+									{
+										if (!pl->bad () && !srv.is_shutting_down ())
+											{
+												pl->load_data ();
+												srv.record_login_stage (LS_RANK,
+													elapsed_us (pl->login_stage_start));
+												
+												pl->finish_login ();
+												srv.record_login_stage (LS_JOIN,
+													elapsed_us (pl->login_stage_start));
+											}
+									}
+								catch (const std::exception& ex)
+									{
+										pl->log (LT_ERROR) << "Exception: " << ex.what () << std::endl;
+										pl->disconnect (false, false);
+									}
+								
+								-- pl->handlers_scheduled;
+							}, pl);
+				}, this);
+	}
+	
+	/* 
+	 * Looks up the player's record (registering the player if this is its
+	 * first time on the server). Runs on the server's database thread.
+	 */
+	void
+	player::fetch_record ()
+	{
+		server &srv = this->get_server ();
+		player_cache& cache = srv.get_player_cache ();
+		
+		// a cached player is registered, so this can't be the first login.
+		if (cache.lookup (this->get_username (), this->login_rec))
+			{
+				this->login_first = false;
+				return;
+			}
+		
+		// make sure that lookups that miss the cache see any pending writes (a
+		// failed flush is logged, and shouldn't prevent the player from joining).
+		srv.flush_sql_writes ();
+		
+		auto& conn = srv.sql ().pop ();
+		
+		try
+			{
+				this->login_first = (cache.count (conn) == 0);
+				if (!cache.fetch (conn, this->get_username (), this->login_rec))
+					{
+						player_record& rec = this->login_rec;
+						rec.name.assign (this->get_username ());
+						rec.nick.assign (this->get_username ());
+						rec.op = this->login_first;
+						if (this->login_first)
+							rec.groups = "@" + srv.get_groups ().highest ()->name;
+						else
+							srv.get_groups ().default_rank.get_string (rec.groups);
+						
+						cache.insert (conn, rec);
+					}
+			}
+		catch (...)
+			{
+				srv.sql ().push (conn);
+				throw;
+			}
+		
+		srv.sql ().push (conn);
+	}
+	
+	/* 
+	 * Resolves the record fetched by fetch_record () into the player's rank,
+	 * nickname, etc...
+	 */
+	void
+	player::load_data ()
+	{
+		const player_record& rec = this->login_rec;
+		
+		if (this->login_first)
+			{
+				this->message ("§4Congratulations§c!");
+				this->message ("§cYou are the first player to log in§7, §cand thus you have been");
+				this->message ("§cgiven the highest rank and have been granted §4operator §cstatus§7.");
+			}
+		
+		this->op = rec.op;
+		try
+			{
+				this->rnk.set (rec.groups.c_str (), this->get_server ().get_groups ());
+			}
+		catch (const std::exception& str)
+			{
+				this->rnk.set (this->get_server ().get_groups ().default_rank);
+				this->log (LT_WARNING) << "Player \"" << this->get_username () << "\" has an invalid rank." << std::endl;
+			}
+		
+		if (rec.nick.size () <= 36)
+			std::strcpy (this->nick, rec.nick.c_str ());
+		else
+			{
+				// don't keep the placeholder nickname assigned on connection.
+				std::strcpy (this->nick, this->get_username ());
+				this->log (LT_WARNING) << "Player \"" << this->get_username () << "\" has an invalid nickname." << std::endl;
+			}
 		
 		std::string str;
 		str.append ("§");
@@ -1243,11 +1525,10 @@ namespace hCraft {
 		
 		if (modify_sql)
 			{
-				std::ostringstream ss;
-				ss << "UPDATE `players` SET `nick`='"
-				 << nick << "' WHERE `name`='"
-				 << this->get_username () << "'";
-				this->get_server ().execute_sql (ss.str ());
+				sqlops::modify_player_nick (this->get_server ().sql (),
+					this->get_username (), nick);
+				this->get_server ().get_player_cache ().set_nick (
+					this->get_username (), nick);
 			}
 	}
 	
@@ -1260,6 +1541,10 @@ namespace hCraft {
 	{
 		this->rnk = rnk;
 		
+		// drop (or start sending) chunks past the new limit right away.
+		if (this->refresh_view_bounds () && this->curr_world && !this->bad ())
+			this->schedule_stream ();
+		
 		// update colored names
 		
 		std::string str;
@@ -1538,7 +1823,7 @@ namespace hCraft {
 				this->send (packet::make_entity_status (this->eid, 2));
 				
 				// notify others too
-				this->get_world ()->get_players ().send_to_all_visible (
+				this->get_world ()->send_to_viewers (this->pos,
 					packet::make_entity_status (this->eid, 2), this);
 				
 				if (hearts <= 0)
@@ -1828,52 +2113,61 @@ namespace hCraft {
 		pl->log () << "Player " << username << " has logged in from @" << pl->get_ip () << std::endl;
 		std::strcpy (pl->username, username);
 		
-		pl->load_data ();
-		pl->handshake = true;
+		// the rest is done asynchronously (see player::begin_login ()).
+		pl->begin_login ();
+		return 0;
+	}
+	
+	/* 
+	 * The last stage of the login pipeline: sends the login packet and joins
+	 * the main world.
+	 */
+	void
+	player::finish_login ()
+	{
+		this->handshake = true;
 		
 		{
 			std::string str;
 			str.append ("§");
-			str.push_back (pl->rnk.main ()->color);
-			str.append (pl->username);
-			std::strcpy (pl->colored_username, str.c_str ());
+			str.push_back (this->rnk.main ()->color);
+			str.append (this->username);
+			std::strcpy (this->colored_username, str.c_str ());
 		}
 		
-		pl->curr_gamemode = GT_CREATIVE;
-		pl->send (packet::make_login (pl->get_eid (), "hCraft", pl->curr_gamemode,
-			0, 0, (pl->get_server ().get_config ().max_players > 64)
-				? 64 : (pl->get_server ().get_config ().max_players)));
-		pl->logged_in = true;
-		if (!pl->get_server ().done_connecting (pl))
-			return 0;
+		this->curr_gamemode = GT_CREATIVE;
+		this->send (packet::make_login (this->get_eid (), "hCraft", this->curr_gamemode,
+			0, 0, (this->get_server ().get_config ().max_players > 64)
+				? 64 : (this->get_server ().get_config ().max_players)));
+		this->logged_in = true;
+		if (!this->get_server ().done_connecting (this))
+			return;
 		
 		// insert self into player list ping
 		{
 			char ping_name[128];
-			get_ping_name (pl->get_rank ().main_group->color, pl->get_username (),
+			get_ping_name (this->get_rank ().main_group->color, this->get_username (),
 				ping_name);
-			//pl->send (packet::make_player_list_item (ping_name, true, pl->ping_time_ms));
+			//this->send (packet::make_player_list_item (ping_name, true, this->ping_time_ms));
 		}
 		
 		{
 			std::ostringstream ss;
-			ss << "§e[§a+§e] " << pl->get_colored_nickname ()
+			ss << "§e[§a+§e] " << this->get_colored_nickname ()
 				 << " §ehas joined the server§f!";
-			pl->get_server ().get_players ().message (ss.str ());
+			this->get_server ().get_players ().message (ss.str ());
 		}
-		pl->join_world (pl->get_server ().get_main_world ());
+		this->join_world (this->get_server ().get_main_world ());
 		
-		pl->inv.subscribe (pl);
+		this->inv.subscribe (this);
 		
-		pl->inv.add (slot_item (IT_FEATHER, 0, 1));
-		pl->inv.add (slot_item (BT_STONE, 0, 1));
+		this->inv.add (slot_item (IT_FEATHER, 0, 1));
+		this->inv.add (slot_item (BT_STONE, 0, 1));
 		
 		slot_item sword (IT_IRON_SWORD, 0, 1);
 		sword.lore.emplace_back ("§7Poison I");
 		sword.enchants.push_back ({ENC_KNOCKBACK, 1});
-		pl->inv.add (sword);
-		
-		return 0;
+		this->inv.add (sword);
 	}
 	
 	int
@@ -2232,7 +2526,7 @@ namespace hCraft {
 								pl->eating = true;
 								
 								// eating animation
-								pl->get_world ()->get_players ().send_to_all_visible (
+								pl->get_world ()->send_to_viewers (pl->pos,
 									packet::make_animation (pl->eid, 5), pl);
 							}
 					}
@@ -2309,7 +2603,7 @@ namespace hCraft {
 			}
 		
 		pl->held_slot = index + 36;
-		pl->get_world ()->get_players ().send_to_all_visible (
+		pl->get_world ()->send_to_viewers (pl->pos,
 			packet::make_entity_equipment (pl->eid, 0, pl->inv.get (pl->held_slot)), pl);
 		return 0;
 	}
@@ -2327,7 +2621,7 @@ namespace hCraft {
 		
 		if (animation == 1)
 			{
-				pl->get_world ()->get_players ().send_to_all_visible (
+				pl->get_world ()->send_to_viewers (pl->pos,
 					packet::make_animation (pl->eid, animation), pl);
 			}
 		
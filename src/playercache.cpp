@@ -0,0 +1,164 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "playercache.hpp"
+#include "sql.hpp"
+
+
+namespace hCraft {
+	
+	player_cache::player_cache ()
+	{
+		this->total = -1;
+	}
+	
+	
+	
+	/* 
+	 * Returns the total number of players registered in the database.
+	 */
+	int
+	player_cache::count (sql::connection& conn)
+	{
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			if (this->total >= 0)
+				return this->total;
+		}
+		
+		int num = 0;
+		sql::row row;
+		auto stmt = conn.query ("SELECT Count(*) FROM `players`");
+		if (stmt.step (row))
+			num = row.at (0).as_int ();
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		if (this->total < 0)
+			this->total = num;
+		return this->total;
+	}
+	
+	/* 
+	 * Fills @{out} with the record of the player that has the given name,
+	 * querying the database if it isn't cached. Returns false if no such
+	 * player is registered.
+	 */
+	bool
+	player_cache::fetch (sql::connection& conn, const char *name,
+		player_record& out)
+	{
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			auto itr = this->records.find (cistring (name));
+			if (itr != this->records.end ())
+				{
+					out = itr->second;
+					return true;
+				}
+		}
+		
+		sql::row row;
+		auto stmt = conn.query (
+			"SELECT `name`, `op`, `groups`, `nick` FROM `players` WHERE `name`=?");
+		stmt.bind (1, name, sql::pass_transient);
+		if (!stmt.step (row))
+			return false;
+		
+		out.name.assign (row.at (0).as_cstr ());
+		out.op = (row.at (1).as_int () == 1);
+		out.groups.assign (row.at (2).as_cstr ());
+		out.nick.assign (row.at (3).as_cstr ());
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		this->records[cistring (name)] = out;
+		return true;
+	}
+	
+	/* 
+	 * Fills @{out} with the cached record of the player that has the given
+	 * name, without going through the database. Returns false if the player
+	 * isn't cached.
+	 */
+	bool
+	player_cache::lookup (const char *name, player_record& out)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->records.find (cistring (name));
+		if (itr == this->records.end ())
+			return false;
+		
+		out = itr->second;
+		return true;
+	}
+	
+	/* 
+	 * Registers a new player in the database (and the cache).
+	 */
+	void
+	player_cache::insert (sql::connection& conn, const player_record& rec)
+	{
+		auto stmt = conn.query (
+			"INSERT INTO `players` (`name`, `op`, `groups`, `nick`) VALUES (?, ?, ?, ?)");
+		stmt.bind (1, rec.name.c_str (), sql::pass_transient);
+		stmt.bind (2, rec.op ? 1 : 0);
+		stmt.bind (3, rec.groups.c_str (), sql::pass_transient);
+		stmt.bind (4, rec.nick.c_str (), sql::pass_transient);
+		stmt.execute ();
+		
+		std::lock_guard<std::mutex> guard {this->lock};
+		this->records[cistring (rec.name.c_str ())] = rec;
+		if (this->total >= 0)
+			++ this->total;
+	}
+	
+	/* 
+	 * Modify the cached record of the player with the given name, if it is
+	 * cached.
+	 */
+	
+	void
+	player_cache::set_nick (const char *name, const char *nick)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->records.find (cistring (name));
+		if (itr != this->records.end ())
+			itr->second.nick.assign (nick);
+	}
+	
+	void
+	player_cache::set_groups (const char *name, const char *groups)
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		auto itr = this->records.find (cistring (name));
+		if (itr != this->records.end ())
+			itr->second.groups.assign (groups);
+	}
+	
+	/* 
+	 * Drops all cached records.
+	 */
+	void
+	player_cache::clear ()
+	{
+		std::lock_guard<std::mutex> guard {this->lock};
+		this->records.clear ();
+		this->total = -1;
+	}
+}
+
@@ -38,6 +38,7 @@ namespace hCraft {
 		this->can_chat = true;
 		this->can_build = true;
 		this->can_move = true;
+		this->view_dist = 0;
 		this->all_perms = false;
 		this->no_perms = false;
 		this->ladder = nullptr;
@@ -517,6 +518,20 @@ namespace hCraft {
 		return false;
 	}
 	
+	/* 
+	 * Returns the largest view distance allowed by the rank's groups, or
+	 * zero if none of them sets one.
+	 */
+	int
+	rank::view_distance () const
+	{
+		int dist = 0;
+		for (group *grp : this->groups)
+			if (grp->view_dist > dist)
+				dist = grp->view_dist;
+		return dist;
+	}
+	
 	
 	
 	/* 
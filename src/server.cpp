@@ -249,6 +249,39 @@ namespace hCraft {
 			}
 	}
 	
+	/* 
+	 * Commits writes queued up in the SQL connection pool.
+	 */
+	void
+	server::flush_sql (scheduler_task& task)
+	{
+		server &srv = *(static_cast<server *> (task.get_context ()));
+		if (!srv.is_running ())
+			return;
+		
+		srv.flush_sql_writes ();
+	}
+	
+	/* 
+	 * Executes the writes queued up in the SQL connection pool, logging
+	 * any failure (failed writes stay queued for the next flush).
+	 * Returns false if some writes could not be executed.
+	 */
+	bool
+	server::flush_sql_writes ()
+	{
+		try
+			{
+				this->sql ().flush ();
+				return true;
+			}
+		catch (const std::exception& ex)
+			{
+				this->log (LT_ERROR) << "Failed to flush pending SQL writes: " << ex.what () << std::endl;
+				return false;
+			}
+	}
+	
 	
 	
 	/* 
@@ -457,6 +490,8 @@ namespace hCraft {
 		std::strcpy (out.srv_motd, "§6A new §ehCraft §6server is born§f!");
 		out.max_players = 12;
 		std::strcpy (out.main_world, "main");
+		out.min_view_dist = 2;
+		out.max_view_dist = 5;
 		
 		std::strcpy (out.ip, "0.0.0.0");
 		out.port = 25565;
@@ -481,6 +516,10 @@ namespace hCraft {
 				= in.max_players;
 			grp_general.add ("main-world", libconfig::Setting::TypeString)
 				= in.main_world;
+			grp_general.add ("min-view-distance", libconfig::Setting::TypeInt)
+				= in.min_view_dist;
+			grp_general.add ("max-view-distance", libconfig::Setting::TypeInt)
+				= in.max_view_dist;
 		}
 		
 		/* 'network' group */
@@ -570,6 +609,23 @@ namespace hCraft {
 						error = true;
 					}
 			}
+		
+		// view distance bounds
+		int min_view = out.min_view_dist, max_view = out.max_view_dist;
+		grp_general.lookupValue ("min-view-distance", min_view);
+		grp_general.lookupValue ("max-view-distance", max_view);
+		if (min_view >= 1 && max_view <= 15 && min_view <= max_view)
+			{
+				out.min_view_dist = min_view;
+				out.max_view_dist = max_view;
+			}
+		else
+			{
+				if (!error)
+					log (LT_ERROR) << "Config: at group \"server.general\":" << std::endl;
+				log (LT_INFO) << " - \"min-view-distance\" and \"max-view-distance\" must be in the range of 1-15, and the minimum cannot exceed the maximum." << std::endl;
+				error = true;
+			}
 	}
 	
 	static void
@@ -708,11 +764,21 @@ namespace hCraft {
 		
 		
 		this->sql ().push (conn); 
+		
+		this->db_exec.start (1);
 	}
 	
 	void
 	server::destroy_sql ()
 	{
+		this->db_exec.stop ();
+		
+		// write out whatever is still queued. Writes that keep failing are
+		// eventually dropped by the pool, so this doesn't go on forever.
+		while (!this->flush_sql_writes () && (this->sql ().pending_writes () > 0))
+			std::this_thread::sleep_for (std::chrono::milliseconds (100));
+		
+		this->pcache.clear ();
 		this->sql ().clear ();
 	}
 	
@@ -742,14 +808,22 @@ namespace hCraft {
 		
 		this->get_scheduler ().new_task (hCraft::server::cleanup_players, this)
 			.run_forever (10000);
+		this->get_scheduler ().new_task (hCraft::server::flush_sql, this)
+			.run_forever (500);
 		
 		// create pooled threads
 		this->tpool.start (6);
+		
+		// lighting is spread across all cores but one, no matter how many worlds
+		// are loaded (world threads take part in lighting their own worlds).
+		unsigned int hw = std::thread::hardware_concurrency ();
+		this->light_pool.start ((hw > 1) ? (hw - 1) : 1);
 	}
 	
 	void
 	server::destroy_core ()
 	{
+		this->light_pool.stop ();
 		this->tpool.stop ();
 		this->sched.stop ();
 		
@@ -802,6 +876,7 @@ namespace hCraft {
 		_add_command (this->perms, this->commands, "polygon");
 		_add_command (this->perms, this->commands, "curve");
 		_add_command (this->perms, this->commands, "rank");
+		_add_command (this->perms, this->commands, "status");
 	}
 	
 	void
@@ -860,6 +935,7 @@ namespace hCraft {
 		grp_moderator->color = 'c';
 		grp_moderator->inherit (grp_designer);
 		grp_moderator->add ("command.misc.ping");
+		grp_moderator->add ("command.info.status");
 		
 		group* grp_admin = groups.add (7, "admin");
 		grp_admin->color = '4';
@@ -1047,6 +1123,7 @@ namespace hCraft {
 		bool grp_can_build;
 		bool grp_can_move;
 		bool grp_can_chat;
+		int grp_view_dist;
 		std::vector<std::string> perms;
 		
 		// inheritance
@@ -1145,6 +1222,12 @@ namespace hCraft {
 		catch (const std::exception&)
 			{ grp_can_chat = true; }
 		
+		// view-distance
+		try
+			{ grp_view_dist = grp_set["view-distance"]; }
+		catch (const std::exception&)
+			{ grp_view_dist = 0; }
+		
 		// permissions
 		try
 			{
@@ -1171,6 +1254,7 @@ namespace hCraft {
 		grp->can_build = grp_can_build;
 		grp->can_move = grp_can_move;
 		grp->can_chat = grp_can_chat;
+		grp->view_dist = grp_view_dist;
 		for (auto& perm : perms)
 			{ 
 				grp->add (perm.c_str ());
@@ -20,6 +20,9 @@
 #include <sqlite3.h>
 #include <chrono>
 #include <thread>
+#include <unordered_map>
+#include <iterator>
+#include <string>
 #include <iostream> // DEBUG
 
 
@@ -538,6 +541,195 @@ namespace hCraft {
 			this->free_conns.clear ();
 			this->conns.clear ();
 		}
+		
+		
+		
+		/* 
+		 * Queues the specified write to be executed on the next flush.
+		 */
+		void
+		connection_pool::defer (deferred_write&& w)
+		{
+			std::lock_guard<std::mutex> guard {this->write_lock};
+			this->writes.push_back (std::move (w));
+		}
+		
+		/* 
+		 * Executes all queued writes in a single transaction, preparing each
+		 * distinct statement only once. Returns the number of writes executed.
+		 * 
+		 * If the transaction fails, the writes are retried one by one, in
+		 * order, up to the first one that fails. That write and all those
+		 * after it are put back at the front of the queue, and sql_error is
+		 * thrown. A write that keeps failing is dropped after a few flushes,
+		 * so that it doesn't hold back the rest of the queue forever.
+		 */
+		int
+		connection_pool::flush ()
+		{
+			const static int max_attempts = 5;
+			std::lock_guard<std::mutex> flush_guard {this->flush_lock};
+			
+			std::vector<deferred_write> batch;
+			{
+				std::lock_guard<std::mutex> guard {this->write_lock};
+				batch.swap (this->writes);
+			}
+			if (batch.empty ())
+				return 0;
+			
+			std::chrono::steady_clock::time_point start
+				= std::chrono::steady_clock::now ();
+			
+			int count = (int)batch.size ();
+			int done = 0;
+			std::string error;
+			connection& conn = this->pop ();
+			{
+				std::unordered_map<std::string, statement> stmts;
+				auto run = [&conn, &stmts] (const deferred_write& w)
+					{
+						auto itr = stmts.find (w.sql);
+						if (itr == stmts.end ())
+							itr = stmts.emplace (w.sql, conn.query (w.sql)).first;
+						
+						statement& stmt = itr->second;
+						stmt.reset ();
+						w.apply (stmt);
+						stmt.execute ();
+					};
+				
+				// NOTE: the transaction is handled by hand rather than through the
+				//       transaction class, since rolling back might fail as well.
+				bool committed = false;
+				try
+					{
+						conn.execute ("BEGIN TRANSACTION");
+						try
+							{
+								for (const deferred_write& w : batch)
+									run (w);
+								conn.execute ("COMMIT TRANSACTION");
+								committed = true;
+							}
+						catch (const sql_error&)
+							{
+								try { conn.execute ("ROLLBACK TRANSACTION"); }
+								catch (const sql_error&) { }
+							}
+					}
+				catch (const sql_error&)
+					{ }
+				
+				if (committed)
+					done = count;
+				else
+					{
+						// find the write that failed, committing those before it.
+						for (; done < count; ++done)
+							{
+								try
+									{
+										run (batch[done]);
+									}
+								catch (const sql_error& ex)
+									{
+										error.assign (ex.what ());
+										break;
+									}
+							}
+					}
+			}
+			this->push (conn);
+			
+			this->flush_times.add ((unsigned int)std::chrono::duration_cast<
+				std::chrono::microseconds> (std::chrono::steady_clock::now () - start).count ());
+			if (done == count)
+				return count;
+			
+			// keep the queue in order: the failed write and everything after it
+			// go before writes deferred in the meantime.
+			deferred_write& failed = batch[done];
+			bool dropped = (++ failed.attempts >= max_attempts);
+			{
+				std::lock_guard<std::mutex> guard {this->write_lock};
+				this->writes.insert (this->writes.begin (),
+					std::make_move_iterator (batch.begin () + done + (dropped ? 1 : 0)),
+					std::make_move_iterator (batch.end ()));
+			}
+			
+			if (dropped)
+				throw sql_error ("dropped write \"" + failed.sql + "\" after "
+					+ std::to_string (max_attempts) + " failed attempts: " + error);
+			throw sql_error ("write failed (will be retried): " + error);
+		}
+		
+		/* 
+		 * Returns the number of writes waiting for the next flush.
+		 */
+		int
+		connection_pool::pending_writes ()
+		{
+			std::lock_guard<std::mutex> guard {this->write_lock};
+			return (int)this->writes.size ();
+		}
+	
+	
+	
+	//----
+		
+		deferred_write::deferred_write (const char *sql)
+			: sql (sql)
+		{
+			this->attempts = 0;
+		}
+		
+		
+		deferred_write::param&
+		deferred_write::at (int index)
+		{
+			if (index < 1)
+				throw sql_error ("invalid parameter index");
+			if ((int)this->params.size () < index)
+				this->params.resize (index, param {true, 0, std::string ()});
+			return this->params[index - 1];
+		}
+		
+		/* 
+		 * Parameter binding (indices start at 1, as with statements):
+		 */
+		
+		deferred_write&
+		deferred_write::bind (int index, int val)
+		{
+			param& p = this->at (index);
+			p.is_int = true;
+			p.ival = val;
+			return *this;
+		}
+		
+		deferred_write&
+		deferred_write::bind (int index, const char *val)
+		{
+			param& p = this->at (index);
+			p.is_int = false;
+			p.sval.assign (val);
+			return *this;
+		}
+		
+		
+		void
+		deferred_write::apply (statement& stmt) const
+		{
+			for (int i = 0; i < (int)this->params.size (); ++i)
+				{
+					const param& p = this->params[i];
+					if (p.is_int)
+						stmt.bind (i + 1, p.ival);
+					else
+						stmt.bind (i + 1, p.sval.c_str (), pass_transient);
+				}
+		}
 	
 	
 	
@@ -87,18 +87,28 @@ namespace hCraft {
 	
 	/* 
 	 * Changes the rank of the player that has the specified name.
+	 * NOTE: The write is deferred to the pool's next flush.
 	 */
 	void
-	sqlops::modify_player_rank (sql::connection& conn, const char *name,
+	sqlops::modify_player_rank (sql::connection_pool& pool, const char *name,
 		const char *rankstr)
 	{
-		auto stmt = conn.query ("UPDATE `players` SET `groups`=? WHERE `name`=?");
-		stmt.bind (1, rankstr, sql::pass_transient);
-		stmt.bind (2, name, sql::pass_transient);
-		
-		sql::row row;
-		while (stmt.step (row))
-			;
+		sql::deferred_write w {"UPDATE `players` SET `groups`=? WHERE `name`=?"};
+		w.bind (1, rankstr).bind (2, name);
+		pool.defer (std::move (w));
+	}
+	
+	/* 
+	 * Changes the nickname of the player that has the specified name.
+	 * NOTE: The write is deferred to the pool's next flush.
+	 */
+	void
+	sqlops::modify_player_nick (sql::connection_pool& pool, const char *name,
+		const char *nick)
+	{
+		sql::deferred_write w {"UPDATE `players` SET `nick`=? WHERE `name`=?"};
+		w.bind (1, nick).bind (2, name);
+		pool.defer (std::move (w));
 	}
 }
 
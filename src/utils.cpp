@@ -20,6 +20,7 @@
 #include <chrono>
 #include <zlib.h>
 #include <cstring>
+#include <algorithm>
 
 
 namespace hCraft {
@@ -39,6 +40,63 @@ namespace hCraft {
 		
 		
 		
+	//-----
+		
+		sample_window::sample_window (unsigned int capacity)
+		{
+			this->capacity = (capacity > 0) ? capacity : 1;
+			this->next = 0;
+			this->samples.reserve (this->capacity);
+		}
+		
+		
+		void
+		sample_window::add (unsigned int val)
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			if (this->samples.size () < this->capacity)
+				this->samples.push_back (val);
+			else
+				{
+					this->samples[this->next] = val;
+					this->next = (this->next + 1) % this->capacity;
+				}
+		}
+		
+		void
+		sample_window::clear ()
+		{
+			std::lock_guard<std::mutex> guard {this->lock};
+			this->samples.clear ();
+			this->next = 0;
+		}
+		
+		
+		/* 
+		 * Returns the value below which @{p} percent of the samples fall
+		 * (0 if there are no samples).
+		 */
+		unsigned int
+		sample_window::percentile (double p)
+		{
+			std::vector<unsigned int> sorted;
+			{
+				std::lock_guard<std::mutex> guard {this->lock};
+				sorted = this->samples;
+			}
+			
+			if (sorted.empty ())
+				return 0;
+			if (p < 0.0) p = 0.0;
+			else if (p > 100.0) p = 100.0;
+			
+			size_t n = (size_t)(p / 100.0 * (sorted.size () - 1) + 0.5);
+			std::nth_element (sorted.begin (), sorted.begin () + n, sorted.end ());
+			return sorted[n];
+		}
+		
+		
+		
 	//-----
 		
 		/* 
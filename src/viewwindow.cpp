@@ -0,0 +1,132 @@
+/* 
+ * hCraft - A custom Minecraft server.
+ * Copyright (C) 2012	Jacob Zhitomirsky
+ * 
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * 
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ * 
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+
+#include "viewwindow.hpp"
+#include <algorithm>
+
+
+namespace hCraft {
+	
+	/* 
+	 * Constructs an empty window that can span up to @{max_radius} chunks
+	 * in every direction from its center.
+	 */
+	view_window::view_window (int max_radius)
+	{
+		this->radius = max_radius;
+		this->max_radius = max_radius;
+		this->shift = 0;
+		while ((1 << this->shift) < (2 * max_radius + 1))
+			++ this->shift;
+		this->size = 1 << this->shift;
+		this->bits.assign (this->size * this->size, 0);
+		this->centered = false;
+	}
+	
+	
+	
+	/* 
+	 * Checks whether the chunk at the given chunk coordinates is known.
+	 */
+	bool
+	view_window::contains (int x, int z) const
+	{
+		if (!this->centered || !in_square (x, z, this->center, this->radius))
+			return false;
+		return this->bits[this->slot_of (x, z)];
+	}
+	
+	/* 
+	 * Marks the given chunk as known/unknown. The chunk must be within
+	 * the window's current square.
+	 */
+	void
+	view_window::insert (int x, int z)
+	{
+		if (this->centered && in_square (x, z, this->center, this->radius))
+			this->bits[this->slot_of (x, z)] = 1;
+	}
+	
+	void
+	view_window::erase (int x, int z)
+	{
+		if (this->centered && in_square (x, z, this->center, this->radius))
+			this->bits[this->slot_of (x, z)] = 0;
+	}
+	
+	/* 
+	 * Forgets about all chunks.
+	 */
+	void
+	view_window::clear ()
+	{
+		std::fill (this->bits.begin (), this->bits.end (), 0);
+		this->centered = false;
+	}
+	
+	
+	
+	/* 
+	 * Centers the window at @{c} and sets its radius to @{radius} (clamped
+	 * to the maximum radius). Known chunks that fall outside of the new
+	 * square are forgotten and appended to @{dropped}, and chunks inside of
+	 * it that are not known yet are appended to @{missing}.
+	 */
+	void
+	view_window::recenter (chunk_pos c, int radius,
+		std::vector<chunk_pos>& dropped, std::vector<chunk_pos>& missing)
+	{
+		if (radius > this->max_radius)
+			radius = this->max_radius;
+		else if (radius < 0)
+			radius = 0;
+		int pr = this->radius;
+		int r = radius;
+		
+		// clear the part of the old square that the new one doesn't cover
+		// first, since its slots are about to be reused.
+		if (this->centered)
+			{
+				chunk_pos o = this->center;
+				for (int x = o.x - pr; x <= o.x + pr; ++x)
+					for (int z = o.z - pr; z <= o.z + pr; ++z)
+						{
+							if (in_square (x, z, c, r))
+								continue;
+							
+							unsigned char& bit = this->bits[this->slot_of (x, z)];
+							if (bit)
+								{
+									bit = 0;
+									dropped.push_back (chunk_pos (x, z));
+								}
+						}
+			}
+		
+		this->center = c;
+		this->radius = r;
+		this->centered = true;
+		
+		for (int x = c.x - r; x <= c.x + r; ++x)
+			for (int z = c.z - r; z <= c.z + r; ++z)
+				if (!this->bits[this->slot_of (x, z)])
+					missing.push_back (chunk_pos (x, z));
+	}
+}
+
@@ -21,6 +21,7 @@
 #include "playerlist.hpp"
 #include "player.hpp"
 #include "packet.hpp"
+#include "pickup.hpp"
 #include "logger.hpp"
 #include <stdexcept>
 #include <cassert>
@@ -47,6 +48,191 @@ namespace hCraft {
 	chunk_coords (unsigned long long key, int* x, int* z)
 		{ *x = key & 0xFFFFFFFFU; *z = key >> 32; }
 	
+	static inline unsigned long long
+	block_key (int x, int y, int z)
+		{ return ((unsigned long long)(x & 0x3FFFFFF) << 34)
+			| ((unsigned long long)(z & 0x3FFFFFF) << 8)
+			| (unsigned long long)(y & 0xFF); }
+	
+	
+	
+	/* 
+	 * The 3x3 group of chunks surrounding a center chunk, resolved through
+	 * neighbour links. Used to look at the blocks around a position without
+	 * going through the world's chunk table.
+	 */
+	struct chunk_window
+	{
+		chunk *center;
+		int cx, cz;
+		chunk *chunks[3][3]; // [x + 1][z + 1]
+		unsigned int gen;    // the world's replace_gen when the window was set
+		
+		chunk_window ()
+			{ this->center = nullptr; }
+		
+		void
+		set_center (chunk *ch, int cx, int cz, unsigned int gen)
+		{
+			this->center = ch;
+			this->cx = cx;
+			this->cz = cz;
+			this->gen = gen;
+			
+			chunk *n = ch->north, *s = ch->south;
+			chunk *w = ch->west, *e = ch->east;
+			this->chunks[1][1] = ch;
+			this->chunks[1][0] = n;
+			this->chunks[1][2] = s;
+			this->chunks[0][1] = w;
+			this->chunks[2][1] = e;
+			this->chunks[0][0] = n ? n->west : (w ? w->north : nullptr);
+			this->chunks[2][0] = n ? n->east : (e ? e->north : nullptr);
+			this->chunks[0][2] = s ? s->west : (w ? w->south : nullptr);
+			this->chunks[2][2] = s ? s->east : (e ? e->south : nullptr);
+		}
+		
+		/* 
+		 * Returns the subchunk that contains the specified block, if it is
+		 * within the window, is loaded, and has physics blocks in it.
+		 */
+		inline subchunk*
+		get_physics_sub (int x, int y, int z)
+		{
+			chunk *ch = this->chunks[(x >> 4) - this->cx + 1][(z >> 4) - this->cz + 1];
+			if (!ch) return nullptr;
+			subchunk *sub = ch->get_sub (y >> 4);
+			return (sub && sub->has_physics ()) ? sub : nullptr;
+		}
+	};
+	
+	
+	
+	block_update_queue::block_update_queue ()
+	{
+		this->count = 0;
+	}
+	
+	block_update_queue::~block_update_queue ()
+	{
+		this->clear ();
+	}
+	
+	
+	void
+	block_update_queue::push (const block_update& u)
+	{
+		unsigned long long key = chunk_key (u.x >> 4, u.z >> 4);
+		chunk_updates *cu;
+		auto itr = this->chunks.find (key);
+		if (itr == this->chunks.end ())
+			{
+				cu = new chunk_updates ();
+				cu->head = 0;
+				this->chunks[key] = cu;
+				this->order.push_back (key);
+			}
+		else
+			cu = itr->second;
+		
+		unsigned short index = (u.y << 8) | ((u.z & 0xF) << 4) | (u.x & 0xF);
+		auto sitr = cu->slots.find (index);
+		if (sitr != cu->slots.end ())
+			{
+				// coalesce
+				block_update& prev = cu->items[sitr->second];
+				player *pl = u.pl ? u.pl : prev.pl;
+				bool physics = u.physics || prev.physics;
+				prev = u;
+				prev.pl = pl;
+				prev.physics = physics;
+				return;
+			}
+		
+		cu->slots[index] = cu->items.size ();
+		cu->items.push_back (u);
+		++ this->count;
+	}
+	
+	
+	/* 
+	 * Removes no more than @{max} updates and appends them to @{out}, one
+	 * chunk after another. Returns the number of updates removed.
+	 */
+	int
+	block_update_queue::pop (std::vector<block_update>& out, int max)
+	{
+		int popped = 0;
+		while (!this->order.empty () && (popped < max))
+			{
+				unsigned long long key = this->order.front ();
+				chunk_updates *cu = this->chunks[key];
+				
+				while ((cu->head < cu->items.size ()) && (popped < max))
+					{
+						block_update& u = cu->items[cu->head++];
+						cu->slots.erase ((u.y << 8) | ((u.z & 0xF) << 4) | (u.x & 0xF));
+						out.push_back (u);
+						++ popped;
+					}
+				
+				if (cu->head == cu->items.size ())
+					{
+						this->chunks.erase (key);
+						this->order.pop_front ();
+						delete cu;
+					}
+			}
+		
+		this->count -= popped;
+		return popped;
+	}
+	
+	/* 
+	 * Discards all queued updates for which @{pred} returns true.
+	 * Returns the number of updates removed.
+	 */
+	int
+	block_update_queue::erase_if (std::function<bool (const block_update&)> pred)
+	{
+		int erased = 0;
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			{
+				chunk_updates *cu = itr->second;
+				
+				std::vector<block_update> kept;
+				for (unsigned int i = cu->head; i < cu->items.size (); ++i)
+					if (!pred (cu->items[i]))
+						kept.push_back (cu->items[i]);
+				if (kept.size () == (cu->items.size () - cu->head))
+					continue;
+				
+				erased += (cu->items.size () - cu->head) - kept.size ();
+				cu->items.swap (kept);
+				cu->head = 0;
+				cu->slots.clear ();
+				for (unsigned int i = 0; i < cu->items.size (); ++i)
+					{
+						block_update& u = cu->items[i];
+						cu->slots[(u.y << 8) | ((u.z & 0xF) << 4) | (u.x & 0xF)] = i;
+					}
+			}
+		
+		// chunks left without updates are removed by pop ().
+		this->count -= erased;
+		return erased;
+	}
+	
+	void
+	block_update_queue::clear ()
+	{
+		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
+			delete itr->second;
+		this->chunks.clear ();
+		this->order.clear ();
+		this->count = 0;
+	}
+	
 	
 	
 	/* 
@@ -54,7 +240,8 @@ namespace hCraft {
 	 */
 	world::world (server &srv, const char *name, logger &log, world_generator *gen,
 		world_provider *provider)
-		: srv (srv), log (log), lm (log, this), estage (this)
+		: srv (srv), log (log), lm (log, this),
+		  estage (this)
 	{
 		assert (world::is_valid_name (name));
 		std::strcpy (this->name, name);
@@ -65,12 +252,13 @@ namespace hCraft {
 		
 		this->prov = provider;
 		this->edge_chunk = nullptr;
-		this->last_chunk = {0, 0, nullptr};
 		
 		this->players = new playerlist ();
 		this->th_running = false;
 		this->auto_lighting = true;
 		this->ticks = 0;
+		this->skipped_ticks = 0;
+		this->replace_gen = 0;
 		
 		// physics blocks
 		{
@@ -78,7 +266,8 @@ namespace hCraft {
 	{ B *a = new B ();        \
 		if (a->id () >= (int)this->phblocks.size ()) \
 			this->phblocks.resize (a->id () + 1); \
-		this->phblocks[a->id ()].reset (a); }
+		this->phblocks[a->id ()].reset (a); \
+		subchunk::register_physics_id (a->id ()); }
 			REGISTER_PHYSICS (physics::sand)
 			REGISTER_PHYSICS (physics::langtons_ant)
 			REGISTER_PHYSICS (physics::water)
@@ -111,7 +300,16 @@ namespace hCraft {
 					delete ch;
 				}
 			this->chunks.clear ();
+			this->chunk_index.clear ();
+			
+			for (chunk *ch : this->replaced_chunks)
+				delete ch;
+			this->replaced_chunks.clear ();
 		}
+		
+		for (pending_commit *pc : this->commits)
+			delete pc;
+		this->commits.clear ();
 	}
 	
 	
@@ -147,6 +345,8 @@ namespace hCraft {
 		if (this->th_running)
 			return;
 		
+		this->lm.set_pool (&this->srv.get_lighting_pool ());
+		
 		this->th_running = true;
 		this->th.reset (new std::thread (
 			std::bind (std::mem_fn (&hCraft::world::worker), this)));
@@ -167,6 +367,15 @@ namespace hCraft {
 		if (this->th->joinable ())
 			this->th->join ();
 		this->th.reset ();
+		
+		// finish off edits that are still being committed.
+		{
+			std::lock_guard<std::mutex> guard {this->update_lock};
+			while (this->commit_slice (std::chrono::hours (1)))
+				;
+		}
+		
+		this->lm.set_pool (nullptr);
 	}
 	
 	
@@ -179,14 +388,35 @@ namespace hCraft {
 	{
 		const static int block_update_cap = 10000; // per tick
 		const static int light_update_cap = 10000; // per tick
+		const static std::chrono::milliseconds tick_period (5);
+		const static int max_tick_lag = 40; // in ticks
+		const static std::chrono::microseconds commit_slice_time (2000);
+		const static int view_check_interval = 200; // ticks (1 second)
+		const static int view_late_limit = 20; // late ticks per check
+		typedef std::chrono::steady_clock tick_clock;
 		
-		int update_count;
 		dense_edit_stage pl_tr;
+		std::vector<block_update> batch;
+		std::unordered_set<unsigned long long> notified;
+		chunk_window window;
+		world::accessor acc {*this};
+		
+		tick_clock::time_point phase_start;
+		auto end_phase = [this, &phase_start] (world_tick_phase phase)
+			{
+				tick_clock::time_point now = tick_clock::now ();
+				this->phase_times[phase].add ((unsigned int)std::chrono::duration_cast<
+					std::chrono::microseconds> (now - phase_start).count ());
+				phase_start = now;
+			};
 		
 		this->ticks = 0;
+		tick_clock::time_point next_tick = tick_clock::now ();
+		int late_ticks = 0; // since the last view distance check
 		while (this->th_running)
 			{
 				++ this->ticks;
+				phase_start = tick_clock::now ();
 				{
 					std::lock_guard<std::mutex> guard {this->update_lock};
 					
@@ -195,21 +425,32 @@ namespace hCraft {
 					 */
 					if (!this->updates.empty ())
 						{
-							std::vector<player *> pl_vc;
-							this->get_players ().populate (pl_vc);
+							batch.clear ();
+							notified.clear ();
+							window.center = nullptr;
+							this->updates.pop (batch, block_update_cap);
 							
-							update_count = 0;
-							while (!this->updates.empty () && (update_count++ < block_update_cap))
-								{
-									block_update &u = this->updates.front ();
+							// edits are only queued while holding the update lock.
+							bool have_commits = (this->pending_commits () > 0);
+							int drained_cx = 0, drained_cz = 0;
+							bool drained = false;
 							
-									block_data old_bd = this->get_block (u.x, u.y, u.z);
-									if (old_bd.id == u.id && old_bd.meta == u.meta)
+							for (block_update& u : batch)
+								{
+									// a chunk that an older edit has yet to reach is committed
+									// before it is modified by newer updates.
+									if (have_commits && (!drained || drained_cx != (u.x >> 4)
+										|| drained_cz != (u.z >> 4)))
 										{
-											// nothing modified
-											this->updates.pop_front ();
-											continue;
+											drained_cx = u.x >> 4;
+											drained_cz = u.z >> 4;
+											drained = true;
+											this->commit_pending_at (drained_cx, drained_cz);
 										}
+									
+									block_data old_bd = acc.get_block (u.x, u.y, u.z);
+									if (old_bd.id == u.id && old_bd.meta == u.meta)
+										continue; // nothing modified
 							
 									block_info *old_inf = block_info::from_id (old_bd.id);
 									block_info *new_inf = block_info::from_id (u.id);
@@ -222,24 +463,18 @@ namespace hCraft {
 									if (((this->width > 0) && ((u.x >= this->width) || (u.x < 0))) ||
 										((this->depth > 0) && ((u.z >= this->depth) || (u.z < 0))) ||
 										((u.y < 0) || (u.y > 255)))
-										{
-											this->updates.pop_front ();
-											continue;
-										}
+										continue;
 							
-									if ((this->get_id (u.x, u.y, u.z) == u.id) &&
-											(this->get_meta (u.x, u.y, u.z) == u.meta))
-										{
-											this->updates.pop_front ();
-											continue;
-										}
+									if ((acc.get_id (u.x, u.y, u.z) == u.id) &&
+											(acc.get_meta (u.x, u.y, u.z) == u.meta))
+										continue;
 									
-									unsigned short old_id = this->get_id (u.x, u.y, u.z);
-									unsigned char old_meta = this->get_meta (u.x, u.y, u.z);
+									unsigned short old_id = acc.get_id (u.x, u.y, u.z);
+									unsigned char old_meta = acc.get_meta (u.x, u.y, u.z);
 									
-									this->set_id_and_meta (u.x, u.y, u.z, u.id, u.meta);
+									acc.set_id_and_meta (u.x, u.y, u.z, u.id, u.meta);
 							
-									chunk *ch = this->get_chunk_at (u.x, u.z);
+									chunk *ch = acc.get_chunk (u.x >> 4, u.z >> 4);
 									if (new_inf->opaque != old_inf->opaque)
 										ch->recalc_heightmap (u.x & 0xF, u.z & 0xF);
 							
@@ -249,7 +484,7 @@ namespace hCraft {
 									if (ch)
 										{
 											if (auto_lighting)
-												this->lm.enqueue_nolock (u.x, u.y, u.z);
+												this->lm.enqueue (u.x, u.y, u.z);
 									
 											// physics
 											if (u.physics && ph)
@@ -265,9 +500,17 @@ namespace hCraft {
 														ph->tick_rate ());
 												}
 									
-											// check neighbouring blocks
+											// check neighbouring blocks (each one is notified at
+											// most once per tick).
+											// neighbours might have been loaded or replaced since the
+											// window was set.
+											unsigned int gen = this->replace_gen.load (
+												std::memory_order_acquire);
+											if (window.center != ch || window.gen != gen)
+												window.set_center (ch, u.x >> 4, u.z >> 4, gen);
 											{
 												physics_block *nph;
+												subchunk *sub;
 												
 												int xx, yy, zz;
 												for (xx = (u.x - 1); xx <= (u.x + 1); ++xx)
@@ -279,8 +522,12 @@ namespace hCraft {
 																if ((yy < 0) || (yy > 255))
 																	continue;
 																
-																nph = this->get_physics_at (xx, yy, zz);
-																if (nph)
+																sub = window.get_physics_sub (xx, yy, zz);
+																if (!sub)
+																	continue;
+																
+																nph = this->get_physics_of (sub->get_id (xx & 0xF, yy & 0xF, zz & 0xF));
+																if (nph && notified.insert (block_key (xx, yy, zz)).second)
 																	{
 																		nph->on_neighbour_modified (*this, xx, yy, zz,
 																			u.x, u.y, u.z);	
@@ -288,36 +535,51 @@ namespace hCraft {
 															}
 											}
 										}
-							
-									this->updates.pop_front ();
 								}
 							
 							// send updates to players
-							pl_tr.preview (pl_vc);
+							pl_tr.preview_to_viewers ();
 							pl_tr.clear ();
 						}
-						
+					
+					/* 
+					 * Pending edit stages.
+					 */
+					this->commit_slice (commit_slice_time);
+					
 				} // release of update lock
+				end_phase (WTP_BLOCKS);
 					
 				/* 
 				 * Lighting updates.
 				 */
 				this->lm.update (light_update_cap);
+				end_phase (WTP_LIGHTING);
 				
 				/* 
 				 * Entities
 				 */
 				{
 					std::lock_guard<std::mutex> lock ((this->entity_lock));
-						for (auto itr = this->entities.begin (); itr != this->entities.end (); )
-							{
-								entity *e = *itr;
-								if (e->tick (*this))
-									itr = this->despawn_entity_nolock (itr);
-								else
-									++ itr;
-							}
+					
+					std::vector<entity *> expired;
+					this->items.tick (*this, this->ticks, expired);
+					for (entity *e : this->generic_ents)
+						{
+							if (e->tick (*this))
+								expired.push_back (e);
+							else
+								this->egrid.move (e);
+						}
+					
+					for (entity *e : expired)
+						{
+							auto itr = this->entities.find (e);
+							if (itr != this->entities.end ())
+								this->despawn_entity_nolock (itr);
+						}
 				}
+				end_phase (WTP_ENTITIES);
 				
 				/* 
 				 * Players
@@ -331,6 +593,26 @@ namespace hCraft {
 							this->get_players ().populate (players);
 							for (player *pl : players)
 								pl->tick (*this);
+							
+							// broadcast movement: every player's tracker encodes what
+							// changed since the last tick, and each player then gets the
+							// updates of those it can see in one batch.
+							for (player *pl : players)
+								pl->tracker.update (pl->get_eid (), pl->pos);
+							for (player *pl : players)
+								pl->send_movement_updates ();
+							for (player *pl : players)
+								pl->tracker.out_len = 0;
+							
+							// adapt view distances to how well the world is keeping up.
+							if ((this->ticks % view_check_interval) == 0)
+								{
+									bool overloaded = (late_ticks > view_late_limit);
+									for (player *pl : players)
+										if (pl->check_output ())
+											pl->adjust_view_distance (overloaded);
+									late_ticks = 0;
+								}
 					
 							// update time (every 4 seconds)
 							// NOTE: a 'world tick' = 5 milliseconds
@@ -339,8 +621,29 @@ namespace hCraft {
 									pl->send (packet::make_time_update (this->ticks / 10, this->ticks / 10));
 						}
 				}
-								
-				std::this_thread::sleep_for (std::chrono::milliseconds (5));
+				end_phase (WTP_PLAYERS);
+				
+				/* 
+				 * Wait for the next tick. Ticks that run late are caught up on by
+				 * starting the next one right away; if we fall too far behind, the
+				 * missed ticks are skipped (but still counted, so that in-game time
+				 * doesn't slow down).
+				 */
+				next_tick += tick_period;
+				tick_clock::time_point now = tick_clock::now ();
+				if (now < next_tick)
+					std::this_thread::sleep_until (next_tick);
+				else
+					{
+						++ late_ticks;
+						if ((now - next_tick) > (tick_period * max_tick_lag))
+							{
+								long long behind = (now - next_tick) / tick_period;
+								this->ticks += behind;
+								this->skipped_ticks += behind;
+								next_tick += tick_period * behind;
+							}
+					}
 			}
 	}
 	
@@ -357,9 +660,9 @@ namespace hCraft {
 			{
 				this->edge_chunk = new chunk ();
 				this->gen->generate_edge (*this, this->edge_chunk);
-				this->edge_chunk->generated = true;
 				this->edge_chunk->recalc_heightmap ();
 				this->lm.relight_chunk (this->edge_chunk);
+				this->edge_chunk->status = CS_READY;
 			}
 	}
 	
@@ -374,9 +677,9 @@ namespace hCraft {
 			{
 				this->edge_chunk = new chunk ();
 				this->gen->generate_edge (*this, this->edge_chunk);
-				this->edge_chunk->generated = true;
 				this->edge_chunk->recalc_heightmap ();
 				this->lm.relight_chunk (this->edge_chunk);
+				this->edge_chunk->status = CS_READY;
 			}
 	}
 	
@@ -395,6 +698,10 @@ namespace hCraft {
 	
 	/* 
 	 * Saves all modified chunks to disk.
+	 * Chunks that have only been generated (and not modified since) are
+	 * skipped, as they can be regenerated from the world's seed. Chunks that
+	 * haven't been generated yet, but hold blocks that spilled over from their
+	 * neighbours, are saved as such, to be generated on top of when loaded.
 	 */
 	void
 	world::save_all ()
@@ -420,12 +727,17 @@ namespace hCraft {
 		for (auto itr = this->chunks.begin (); itr != this->chunks.end (); ++itr)
 			{
 				chunk *ch = itr->second;
-				if (ch->modified)
+				
+				// light changes alone are only saved if the chunk is already on disk
+				// (otherwise it is relit when regenerated).
+				if (ch->modified || (ch->relit && ch->stored))
 					{
 						int x, z;
 						chunk_coords (itr->first, &x, &z);
 						this->prov->save (*this, ch, x, z);
 						ch->modified = false;
+						ch->relit = false;
+						ch->stored = true;
 					}
 			}
 		this->prov->close ();
@@ -514,13 +826,19 @@ namespace hCraft {
 	{
 		unsigned long long key = chunk_key (x, z);
 		
-		std::lock_guard<std::mutex> guard {this->chunk_lock};
+		ready_callback_list fire;
+		std::unique_lock<std::mutex> guard {this->chunk_lock};
+		int delta = (ch->status >= CS_DECORATED) ? 1 : 0;
 		auto itr = this->chunks.find (key);
 		if (itr != this->chunks.end ())
 			{
 				chunk *prev = itr->second;
 				if (prev == ch) return;
-				delete prev;
+				if (prev->status >= CS_DECORATED)
+					-- delta;
+				
+				// get_chunk () doesn't lock, so someone might still be using it.
+				this->replaced_chunks.push_back (prev);
 				this->chunks.erase (itr);
 			}
 		
@@ -570,7 +888,28 @@ namespace hCraft {
 				ch->east = nullptr;
 		}
 		
+		// count decorated neighbours
+		ch->decorated_neighbours = 0;
+		for (int nx = x - 1; nx <= x + 1; ++nx)
+			for (int nz = z - 1; nz <= z + 1; ++nz)
+				{
+					if (nx == x && nz == z)
+						continue;
+					chunk *n = this->get_chunk_nolock (nx, nz);
+					if (n && (n->status >= CS_DECORATED))
+						++ ch->decorated_neighbours;
+				}
+		
 		this->chunks[key] = ch;
+		this->chunk_index.insert (key, ch);
+		++ this->replace_gen; // invalidate accessors and chunk windows
+		if (delta != 0)
+			this->update_neighbours_nolock (x, z, delta, fire);
+		this->try_ready_nolock (ch, x, z, fire);
+		guard.unlock ();
+		
+		for (auto& p : fire)
+			p.second (p.first);
 	}
 	
 	
@@ -587,8 +926,93 @@ namespace hCraft {
 		return nullptr;
 	}
 	
+	void
+	world::update_neighbours_nolock (int x, int z, int delta,
+		ready_callback_list& fire)
+	{
+		for (int nx = x - 1; nx <= x + 1; ++nx)
+			for (int nz = z - 1; nz <= z + 1; ++nz)
+				{
+					if ((nx == x && nz == z) || !this->chunk_in_bounds (nx, nz))
+						continue;
+					
+					auto itr = this->chunks.find (chunk_key (nx, nz));
+					if (itr == this->chunks.end ())
+						continue;
+					
+					chunk *n = itr->second;
+					n->decorated_neighbours += delta;
+					this->try_ready_nolock (n, nx, nz, fire);
+				}
+	}
+	
+	void
+	world::try_ready_nolock (chunk *ch, int x, int z, ready_callback_list& fire)
+	{
+		if (ch->status != CS_LIT || ch->decorated_neighbours < 8)
+			return;
+		
+		ch->status = CS_READY;
+		auto itr = this->ready_waiters.find (chunk_key (x, z));
+		if (itr != this->ready_waiters.end ())
+			{
+				for (auto& f : itr->second)
+					fire.emplace_back (ch, f);
+				this->ready_waiters.erase (itr);
+			}
+	}
+	
+	/* 
+	 * Advances the specified chunk to the given lifecycle stage, updating the
+	 * readiness of its neighbours and notifying waiters of chunks that become
+	 * ready as a result.
+	 */
+	void
+	world::set_chunk_status (chunk *ch, int x, int z, chunk_status status)
+	{
+		ready_callback_list fire;
+		{
+			std::lock_guard<std::mutex> guard {this->chunk_lock};
+			chunk_status prev = ch->status;
+			if (status <= prev)
+				return;
+			
+			ch->status = status;
+			if (prev < CS_DECORATED && status >= CS_DECORATED)
+				this->update_neighbours_nolock (x, z, 1, fire);
+			this->try_ready_nolock (ch, x, z, fire);
+		}
+		
+		for (auto& p : fire)
+			p.second (p.first);
+	}
+	
+	/* 
+	 * Calls the given function once the chunk located at the specified
+	 * coordinates becomes ready (immediately, if it already is).
+	 */
+	void
+	world::when_ready (int x, int z, std::function<void (chunk *)> f)
+	{
+		chunk *ch;
+		{
+			std::lock_guard<std::mutex> guard {this->chunk_lock};
+			ch = this->get_chunk_nolock (x, z);
+			if (!ch || ch->status != CS_READY)
+				{
+					this->ready_waiters[chunk_key (x, z)].push_back (f);
+					return;
+				}
+		}
+		
+		f (ch);
+	}
+	
+	
+	
 	/* 
 	 * Searches the chunk world for a chunk located at the specified coordinates.
+	 * Lock-free.
 	 */
 	chunk*
 	world::get_chunk (int x, int z)
@@ -596,14 +1020,7 @@ namespace hCraft {
 		if (!this->chunk_in_bounds (x, z))
 			return this->edge_chunk;
 		
-		unsigned long long key = chunk_key (x, z);
-		
-		std::lock_guard<std::mutex> guard {this->chunk_lock};
-		auto itr = this->chunks.find (key);
-		if (itr != this->chunks.end ())
-			return itr->second;
-		
-		return nullptr;
+		return this->chunk_index.find (chunk_key (x, z));
 	}
 	
 	/* 
@@ -616,23 +1033,31 @@ namespace hCraft {
 	}
 	
 	chunk*
-	world::load_chunk_at (int bx, int bz)
+	world::load_chunk_at (int bx, int bz, chunk_status status)
 	{
-		return this->load_chunk (bx >> 4, bz >> 4);
+		return this->load_chunk (bx >> 4, bz >> 4, status);
 	}
 	
 	
 	/* 
 	 * Same as get_chunk (), but if the chunk does not exist, it will be either
-	 * loaded from a file (if such a file exists), or completely generated from
-	 * scratch.
+	 * loaded from a file (if such a file exists), or generated from scratch.
+	 * The returned chunk is guaranteed to have reached at least the lifecycle
+	 * stage specified by @{status} (requesting CS_READY causes neighbouring
+	 * chunks to be decorated as well, and requesting CS_EMPTY skips generation
+	 * altogether).
 	 */
 	chunk*
-	world::load_chunk (int x, int z)
+	world::load_chunk (int x, int z, chunk_status status)
 	{
 		chunk *ch = this->get_chunk (x, z);
-		if (ch && ch->generated) return ch;
-		else if (!ch)
+		if (ch && ch->status >= status) return ch;
+		
+		// an ungenerated chunk that already exists has had blocks placed into it
+		// by a neighbouring chunk's generation, and thus cannot be reproduced
+		// from the seed alone.
+		bool prefilled = (ch != nullptr);
+		if (!ch)
 			{
 				ch = new chunk ();
 		
@@ -641,21 +1066,60 @@ namespace hCraft {
 				if (this->prov->load (*this, ch, x, z))
 					{
 						this->prov->close ();
-						this->put_chunk (x, z, ch);
-						ch->recalc_heightmap ();
-						//ch->relight ();
-						return ch;
+						ch->modified = false;
+						ch->relit = false;
+						ch->stored = true;
+						if (ch->status >= CS_DECORATED)
+							{
+								ch->recalc_heightmap ();
+								//ch->relight ();
+								ch->status = CS_LIT;
+								this->put_chunk (x, z, ch);
+								if (status == CS_READY)
+									return this->load_chunk (x, z, CS_READY);
+								return ch;
+							}
+						
+						// a saved placeholder, generated below on top of the blocks
+						// that spilled into it.
+						prefilled = true;
 					}
-				this->prov->close ();
+				else
+					this->prov->close ();
 				
 				//
 				this->put_chunk (x, z, ch);
 			}
 		
-		this->gen->generate (*this, ch, x, z);
-		ch->generated = true;
-		ch->recalc_heightmap ();
-		this->lm.relight_chunk (ch);
+		if (status > CS_EMPTY && ch->status < CS_DECORATED)
+			{
+				this->gen->generate (*this, ch, x, z);
+				this->set_chunk_status (ch, x, z, CS_TERRAIN);
+				this->gen->decorate (*this, ch, x, z);
+				
+				// pristine chunks are not saved, they get regenerated when next needed.
+				ch->modified = prefilled || ch->spilled;
+				this->set_chunk_status (ch, x, z, CS_DECORATED);
+			}
+		
+		if (status >= CS_LIT && ch->status < CS_LIT)
+			{
+				// NOTE: lighting only marks the chunk as relit, not as modified.
+				ch->recalc_heightmap ();
+				this->lm.relight_chunk (ch);
+				this->set_chunk_status (ch, x, z, CS_LIT);
+			}
+		
+		if (status == CS_READY && ch->status < CS_READY)
+			{
+				// the chunk becomes ready once no more blocks can spill into it from
+				// its neighbours.
+				for (int nx = x - 1; nx <= x + 1; ++nx)
+					for (int nz = z - 1; nz <= z + 1; ++nz)
+						if (!(nx == x && nz == z) && this->chunk_in_bounds (nx, nz))
+							this->load_chunk (nx, nz, CS_DECORATED);
+			}
+		
 		return ch;
 	}
 	
@@ -697,6 +1161,10 @@ namespace hCraft {
 				return; // id clash
 			
 			this->entities.insert (e);
+			if (e->get_type () == ET_ITEM)
+				this->items.add (static_cast<pickup_item *> (e));
+			else
+				this->generic_ents.push_back (e);
 		}
 		
 		chunk *ch = this->load_chunk_at ((int)e->pos.x, (int)e->pos.z);
@@ -704,30 +1172,14 @@ namespace hCraft {
 		
 		ch->add_entity (e);
 		e->spawn_time = std::chrono::steady_clock::now ();
+		this->egrid.insert (e);
 		
 		// spawn entity to players
 		chunk_pos cpos = e->pos;
-		int cx, cz;
-		for (cx = (cpos.x - player::chunk_radius ());
-				 cx <= (cpos.x + player::chunk_radius ()); ++cx)
-			{
-				for (cz = (cpos.z - player::chunk_radius ());
-						 cz <= (cpos.z + player::chunk_radius ()); ++cz)
-					{
-						chunk *och = this->get_chunk (cx, cz);
-						if (!och) continue;
-						
-						entity *e_this = e;
-						och->all_entities ([e_this] (entity *e)
-							{
-								if (e->get_type () == ET_PLAYER)
-									{
-										player *pl = dynamic_cast<player *> (e);
-										e_this->spawn_to (pl);
-									}
-							});
-					}
-			}
+		std::vector<player *> viewers;
+		this->interest.get_viewers (cpos.x, cpos.z, viewers);
+		for (player *pl : viewers)
+			e->spawn_to (pl);
 	}
 	
 	
@@ -742,29 +1194,26 @@ namespace hCraft {
 				ch->remove_entity (e);
 			}
 		
-		// despawn from players
-		chunk_pos cpos = e->pos;
-		int cx, cz;
-		for (cx = (cpos.x - player::chunk_radius ());
-				 cx <= (cpos.x + player::chunk_radius ()); ++cx)
+		this->egrid.remove (e);
+		if (e->get_type () == ET_ITEM)
+			this->items.remove (static_cast<pickup_item *> (e));
+		else
 			{
-				for (cz = (cpos.z - player::chunk_radius ());
-						 cz <= (cpos.z + player::chunk_radius ()); ++cz)
+				auto gitr = std::find (this->generic_ents.begin (),
+					this->generic_ents.end (), e);
+				if (gitr != this->generic_ents.end ())
 					{
-						chunk *och = this->get_chunk (cx, cz);
-						if (!och) continue;
-						
-						entity *e_this = e;
-						och->all_entities ([e_this] (entity *e)
-							{
-								if (e->get_type () == ET_PLAYER)
-									{
-										player *pl = dynamic_cast<player *> (e);
-										e_this->despawn_from (pl);
-									}
-							});
+						*gitr = this->generic_ents.back ();
+						this->generic_ents.pop_back ();
 					}
 			}
+		
+		// despawn from players
+		chunk_pos cpos = e->pos;
+		std::vector<player *> viewers;
+		this->interest.get_viewers (cpos.x, cpos.z, viewers);
+		for (player *pl : viewers)
+			e->despawn_from (pl);
 		delete e;
 		
 		auto ret_itr = this->entities.erase (itr);
@@ -794,6 +1243,22 @@ namespace hCraft {
 		for (auto itr = this->entities.begin (); itr != this->entities.end (); ++itr)
 			f (*itr);
 	}
+	
+	
+	/* 
+	 * Sends the specified packet to all players that can see the given
+	 * chunk, except for @{except}. The packet is destroyed afterwards.
+	 */
+	void
+	world::send_to_viewers (chunk_pos cpos, packet *pack, player *except)
+	{
+		std::vector<player *> viewers;
+		this->interest.get_viewers (cpos.x, cpos.z, viewers);
+		for (player *pl : viewers)
+			if (pl != except)
+				pl->send (new packet (*pack));
+		delete pack;
+	}
 		
 	
 	
@@ -805,35 +1270,7 @@ namespace hCraft {
 	void
 	world::set_id (int x, int y, int z, unsigned short id)
 	{
-		chunk *ch = nullptr;
-		if (this->last_chunk.ch)
-			{
-				int dx = this->last_chunk.x - (x >> 4);
-				int dz = this->last_chunk.z - (z >> 4);
-				if (dx == 0)
-					{
-						switch (dz)
-							{
-								case  0: ch = this->last_chunk.ch; break;
-								case  1: ch = ch->south; break;
-								case -1: ch = ch->north; break;
-							}
-					}
-				else if (dz == 0)
-					{
-						switch (dx)
-							{
-								case  0: ch = this->last_chunk.ch; break;
-								case  1: ch = ch->east; break;
-								case -1: ch = ch->west; break;
-							}
-					}
-				
-				if (!ch)
-					ch = this->load_chunk (x >> 4, z >> 4);
-			}
-		else
-			ch = this->load_chunk (x >> 4, z >> 4);
+		chunk *ch = this->load_chunk (x >> 4, z >> 4);
 		ch->set_id (x & 0xF, y, z & 0xF, id);
 	}
 	
@@ -948,8 +1385,586 @@ namespace hCraft {
 	blocki
 	world::get_final_block (int x, int y, int z)
 	{
-		std::lock_guard<std::mutex> guard {this->estage_lock};
-		return this->estage.get (x, y, z);
+		blocki bl;
+		{
+			std::lock_guard<std::mutex> guard {this->estage_lock};
+			if (this->estage.lookup (x, y, z, bl))
+				return bl;
+		}
+		
+		// blocks that are part of an edit that is still being committed.
+		{
+			std::lock_guard<std::mutex> guard {this->commit_lock};
+			for (auto itr = this->commits.rbegin (); itr != this->commits.rend (); ++itr)
+				if ((*itr)->stage->lookup (x, y, z, bl))
+					return bl;
+		}
+		
+		block_data bd = this->get_block (x, y, z);
+		return {bd.id, bd.meta};
+	}
+	
+	
+	
+	/* 
+	 * Takes ownership of the specified edit stage, and commits it to the
+	 * world gradually, in bounded slices over the next few ticks. Progress
+	 * is reported to @{initiator}, if not null, and @{done_msg} is sent to
+	 * it once the last slice lands.
+	 * 
+	 * Block updates queued before the call to blocks that the stage modifies
+	 * are discarded. Updates queued after it to chunks that the stage has
+	 * yet to reach have the chunk committed first.
+	 */
+	void
+	world::queue_commit (dense_edit_stage *stage, bool physics, player *initiator,
+		const std::string& done_msg)
+	{
+		if (!this->th_running)
+			{
+				// nobody is going to process the queue.
+				stage->commit (physics);
+				delete stage;
+				if (initiator && !done_msg.empty ())
+					initiator->message (done_msg);
+				return;
+			}
+		
+		pending_commit *pc = new pending_commit ();
+		pc->stage.reset (stage);
+		pc->physics = physics;
+		if (initiator)
+			pc->initiator = initiator->get_username ();
+		pc->done_msg = done_msg;
+		pc->total = stage->size ();
+		pc->done = 0;
+		pc->reported = -1;
+		pc->bound_min = block_pos ( 0x7FFFFFFF,  0x7FFFFFFF, 0x7FFFFFFF);
+		pc->bound_max = block_pos (-0x7FFFFFFF, -0x7FFFFFFF,-0x7FFFFFFF);
+		
+		// the edit overrides older updates to the same blocks, whether they have
+		// been applied yet or not.
+		std::lock_guard<std::mutex> up_guard {this->update_lock};
+		this->drop_updates (
+			[stage] (int x, int y, int z)
+				{
+					blocki bl;
+					return stage->lookup (x, y, z, bl);
+				});
+		{
+			std::lock_guard<std::mutex> es_guard {this->estage_lock};
+			this->estage.subtract (*stage);
+		}
+		
+		std::lock_guard<std::mutex> guard {this->commit_lock};
+		this->commits.push_back (pc);
+	}
+	
+	/* 
+	 * Immediately commits whatever pending edit stages have staged in the
+	 * specified chunk, oldest first. Must be called with the update lock
+	 * held, before the chunk is modified by a newer edit.
+	 */
+	void
+	world::commit_pending_at (int cx, int cz)
+	{
+		// only the update lock's holder removes commits, so these stay valid.
+		std::vector<pending_commit *> staged;
+		{
+			std::lock_guard<std::mutex> guard {this->commit_lock};
+			for (pending_commit *pc : this->commits)
+				if (pc->stage->has_chunk (cx, cz))
+					staged.push_back (pc);
+		}
+		
+		for (pending_commit *pc : staged)
+			{
+				int count = pc->stage->commit_at (cx, cz, pc->physics,
+					pc->bound_min, pc->bound_max, &this->commit_lock);
+				if (count > 0)
+					pc->done += count;
+			}
+	}
+	
+	/* 
+	 * Discards queued block updates to those blocks for which @{pred}
+	 * returns true, as they are about to be overwritten by a newer edit.
+	 * Must be called with the update lock held.
+	 */
+	void
+	world::drop_updates (std::function<bool (int x, int y, int z)> pred)
+	{
+		this->updates.erase_if (
+			[&pred] (const block_update& u)
+				{
+					return pred (u.x, u.y, u.z);
+				});
+	}
+	
+	/* 
+	 * Returns the number of edit stages that have yet to be fully committed.
+	 */
+	int
+	world::pending_commits ()
+	{
+		std::lock_guard<std::mutex> guard {this->commit_lock};
+		return this->commits.size ();
+	}
+	
+	
+	/* 
+	 * Commits staged chunks from pending edit stages until @{budget} runs
+	 * out (at least one chunk is always written). Returns true if there is
+	 * still work left. Must be called with the update lock held.
+	 */
+	bool
+	world::commit_slice (std::chrono::microseconds budget)
+	{
+		typedef std::chrono::steady_clock clock;
+		
+		{
+			std::lock_guard<std::mutex> guard {this->commit_lock};
+			if (this->commits.empty ())
+				return false;
+		}
+		
+		clock::time_point end = clock::now () + budget;
+		
+		for (;;)
+			{
+				// only the update lock's holder removes commits, so the front stays
+				// valid.
+				pending_commit *pc;
+				{
+					std::lock_guard<std::mutex> guard {this->commit_lock};
+					if (this->commits.empty ())
+						return false;
+					pc = this->commits.front ();
+				}
+				
+				int count;
+				bool out_of_time = false;
+				while ((count = pc->stage->commit_next (pc->physics,
+					pc->bound_min, pc->bound_max, &this->commit_lock)) != -1)
+					{
+						pc->done += count;
+						if (clock::now () >= end)
+							{ out_of_time = true; break; }
+					}
+				
+				player *pl = nullptr;
+				if (!pc->initiator.empty ())
+					pl = this->srv.get_players ().find (pc->initiator.c_str ());
+				
+				if (out_of_time)
+					{
+						// report progress every 10%
+						int percent = pc->total ? (int)((long long)pc->done * 100 / pc->total) : 100;
+						if (pl && (percent / 10) > (pc->reported / 10))
+							{
+								if (pc->reported == -1)
+									pl->message ("§7 | Committing §b" + std::to_string (pc->total)
+										+ " §7blocks§f...");
+								pl->message ("§7 | §b" + std::to_string (percent) + "% §7done");
+								pc->reported = percent;
+							}
+						return true;
+					}
+				
+				{
+					std::lock_guard<std::mutex> guard {this->commit_lock};
+					this->commits.pop_front ();
+				}
+				
+				std::vector<player *> pl_vc;
+				this->get_players ().populate (pl_vc);
+				dense_edit_stage::refresh_players (pl_vc, pc->bound_min, pc->bound_max);
+				if (pl && !pc->done_msg.empty ())
+					pl->message (pc->done_msg);
+				else if (pl && pc->reported != -1)
+					pl->message ("§7 | Edit complete§f.");
+				delete pc;
+				
+				if (clock::now () >= end)
+					return (this->pending_commits () > 0);
+			}
+	}
+	
+	
+	
+//----
+	
+	/* 
+	 * Orders the corners of the given box and clips it to the specified world
+	 * dimensions. Returns false if nothing is left.
+	 */
+	static bool
+	clip_box (block_pos& min, block_pos& max, int width, int depth)
+	{
+		if (min.x > max.x) std::swap (min.x, max.x);
+		if (min.y > max.y) std::swap (min.y, max.y);
+		if (min.z > max.z) std::swap (min.z, max.z);
+		
+		if (min.y < 0) min.y = 0;
+		if (max.y > 255) max.y = 255;
+		if (width > 0)
+			{
+				if (min.x < 0) min.x = 0;
+				if (max.x >= width) max.x = width - 1;
+			}
+		if (depth > 0)
+			{
+				if (min.z < 0) min.z = 0;
+				if (max.z >= depth) max.z = depth - 1;
+			}
+		
+		return (min.x <= max.x) && (min.y <= max.y) && (min.z <= max.z);
+	}
+	
+	
+	/* 
+	 * Copies the blocks of subchunk @{src} (all air if null) into @{dest}.
+	 * Light values are left untouched.
+	 */
+	static void
+	copy_sub_blocks (subchunk *dest, subchunk *src)
+	{
+		if (!src)
+			{
+				dest->fill (0, 0);
+				return;
+			}
+		
+		std::memcpy (dest->ids, src->ids, 4096);
+		std::memcpy (dest->meta, src->meta, 2048);
+		if (src->add_count > 0)
+			{
+				if (!dest->add)
+					dest->add = new unsigned char[2048];
+				std::memcpy (dest->add, src->add, 2048);
+			}
+		else if (dest->add)
+			{
+				delete[] dest->add;
+				dest->add = nullptr;
+			}
+		
+		dest->add_count = src->add_count;
+		dest->air_count = src->air_count;
+		dest->phys_count = src->phys_count;
+	}
+	
+	/* 
+	 * Calls @{f} on every run of blocks in the box. Runs that lie in chunks
+	 * that aren't loaded are reported as air (their @{sub} is null). Blocks
+	 * staged by edits that are still being committed are reported as if
+	 * they had already been written.
+	 */
+	void
+	world::for_each_run (block_pos min, block_pos max,
+		std::function<void (const block_run&)> f)
+	{
+		if (!clip_box (min, max, this->width, this->depth))
+			return;
+		
+		// subchunks with blocks staged by pending edits are read through a copy
+		// with the staged blocks written over it.
+		bool pending = (this->pending_commits () > 0);
+		std::unique_ptr<subchunk> overlay;
+		
+		block_run run;
+		for (int cx = (min.x >> 4); cx <= (max.x >> 4); ++cx)
+			for (int cz = (min.z >> 4); cz <= (max.z >> 4); ++cz)
+				{
+					chunk *ch = this->get_chunk (cx, cz);
+					int x0 = utils::max (min.x, cx << 4), x1 = utils::min (max.x, (cx << 4) + 15);
+					int z0 = utils::max (min.z, cz << 4), z1 = utils::min (max.z, (cz << 4) + 15);
+					
+					run.x = x0;
+					run.len = x1 - x0 + 1;
+					for (int sy = (min.y >> 4); sy <= (max.y >> 4); ++sy)
+						{
+							run.sub = ch ? ch->get_sub (sy) : nullptr;
+							if (pending)
+								{
+									std::lock_guard<std::mutex> guard {this->commit_lock};
+									bool copied = false;
+									for (pending_commit *pc : this->commits) // oldest first
+										{
+											if (!pc->stage->has_chunk (cx, cz))
+												continue;
+											if (!copied)
+												{
+													if (!overlay)
+														overlay.reset (new subchunk ());
+													copy_sub_blocks (overlay.get (), run.sub);
+													copied = true;
+												}
+											pc->stage->overlay (cx, sy, cz, overlay.get ());
+										}
+									if (copied)
+										run.sub = overlay.get ();
+								}
+							
+							int y0 = utils::max (min.y, sy << 4), y1 = utils::min (max.y, (sy << 4) + 15);
+							for (int y = y0; y <= y1; ++y)
+								for (int z = z0; z <= z1; ++z)
+									{
+										run.y = y;
+										run.z = z;
+										run.index = ((y & 0xF) << 8) | ((z & 0xF) << 4) | (x0 & 0xF);
+										f (run);
+									}
+						}
+				}
+	}
+	
+	/* 
+	 * Calls @{f} on every block in the box.
+	 */
+	void
+	world::for_each_block (block_pos min, block_pos max,
+		std::function<void (int x, int y, int z, unsigned short id,
+			unsigned char meta)> f)
+	{
+		this->for_each_run (min, max,
+			[&f] (const block_run& run)
+				{
+					for (int i = 0; i < run.len; ++i)
+						f (run.x + i, run.y, run.z, run.id (i), run.meta (i));
+				});
+	}
+	
+	/* 
+	 * Reads the IDs and metadata values of all blocks in the box into the
+	 * specified arrays (either of which may be null). Both are laid out as
+	 * [y][z][x], relative to @{min}, and must be large enough to hold the
+	 * entire box. Blocks outside of the world are read as air.
+	 */
+	void
+	world::read_box (block_pos min, block_pos max, unsigned short *ids,
+		unsigned char *meta)
+	{
+		block_pos bmin (utils::min (min.x, max.x), utils::min (min.y, max.y),
+			utils::min (min.z, max.z));
+		int bw = utils::iabs (max.x - min.x) + 1;
+		int bh = utils::iabs (max.y - min.y) + 1;
+		int bd = utils::iabs (max.z - min.z) + 1;
+		
+		size_t total = (size_t)bw * bh * bd;
+		if (ids)
+			std::fill (ids, ids + total, 0);
+		if (meta)
+			std::fill (meta, meta + total, 0);
+		
+		this->for_each_run (min, max,
+			[=] (const block_run& run)
+				{
+					if (!run.sub)
+						return;
+					
+					size_t n = ((size_t)(run.y - bmin.y) * bd + (run.z - bmin.z)) * bw
+						+ (run.x - bmin.x);
+					for (int i = 0; i < run.len; ++i)
+						{
+							if (ids)
+								ids[n + i] = run.id (i);
+							if (meta)
+								meta[n + i] = run.meta (i);
+						}
+				});
+	}
+	
+	/* 
+	 * Writes blocks from the given arrays (laid out as in read_box ()) into
+	 * the box, loading chunks as necessary. If @{meta} is null, metadata
+	 * values are set to zero. Like set_id_and_meta (), this modifies chunks
+	 * directly: players aren't notified, and nothing is relit.
+	 */
+	void
+	world::write_box (block_pos min, block_pos max, const unsigned short *ids,
+		const unsigned char *meta)
+	{
+		block_pos bmin (utils::min (min.x, max.x), utils::min (min.y, max.y),
+			utils::min (min.z, max.z));
+		int bw = utils::iabs (max.x - min.x) + 1;
+		int bd = utils::iabs (max.z - min.z) + 1;
+		
+		if (!clip_box (min, max, this->width, this->depth))
+			return;
+		
+		for (int cx = (min.x >> 4); cx <= (max.x >> 4); ++cx)
+			for (int cz = (min.z >> 4); cz <= (max.z >> 4); ++cz)
+				{
+					chunk *ch = this->load_chunk (cx, cz);
+					int x0 = utils::max (min.x, cx << 4), x1 = utils::min (max.x, (cx << 4) + 15);
+					int z0 = utils::max (min.z, cz << 4), z1 = utils::min (max.z, (cz << 4) + 15);
+					
+					for (int y = min.y; y <= max.y; ++y)
+						for (int z = z0; z <= z1; ++z)
+							{
+								size_t n = ((size_t)(y - bmin.y) * bd + (z - bmin.z)) * bw
+									+ (x0 - bmin.x);
+								for (int x = x0; x <= x1; ++x, ++n)
+									ch->set_id_and_meta (x & 0xF, y, z & 0xF, ids[n],
+										meta ? meta[n] : 0);
+							}
+					
+					for (int x = x0; x <= x1; ++x)
+						for (int z = z0; z <= z1; ++z)
+							ch->recalc_heightmap (x & 0xF, z & 0xF);
+				}
+	}
+	
+	
+	
+//----
+	
+	world::accessor::accessor (world &wr)
+		: wr (wr)
+	{
+		this->cx = this->cz = 0;
+		this->ch = nullptr;
+		this->gen = 0;
+	}
+	
+	
+	chunk*
+	world::accessor::get_chunk (int cx, int cz)
+	{
+		// the remembered chunk (or one of its neighbours) might have been
+		// replaced since it was last used.
+		unsigned int gen = this->wr.replace_gen.load (std::memory_order_acquire);
+		if (gen != this->gen)
+			{
+				this->ch = nullptr;
+				this->gen = gen;
+			}
+		
+		chunk *ch = this->ch;
+		if (ch)
+			{
+				int dx = cx - this->cx;
+				int dz = cz - this->cz;
+				chunk *next = nullptr;
+				if (dz == 0)
+					{
+						switch (dx)
+							{
+								case  0: return ch;
+								case  1: next = ch->east; break;
+								case -1: next = ch->west; break;
+							}
+					}
+				else if (dx == 0)
+					{
+						switch (dz)
+							{
+								case  1: next = ch->south; break;
+								case -1: next = ch->north; break;
+							}
+					}
+				
+				if (next)
+					{
+						this->ch = next;
+						this->cx = cx;
+						this->cz = cz;
+						return next;
+					}
+			}
+		
+		ch = this->wr.get_chunk (cx, cz);
+		if (ch)
+			{
+				this->ch = ch;
+				this->cx = cx;
+				this->cz = cz;
+			}
+		return ch;
+	}
+	
+	chunk*
+	world::accessor::load_chunk (int cx, int cz)
+	{
+		chunk *ch = this->get_chunk (cx, cz);
+		if (ch && (ch->status >= CS_LIT))
+			return ch;
+		
+		ch = this->wr.load_chunk (cx, cz);
+		this->ch = ch;
+		this->cx = cx;
+		this->cz = cz;
+		return ch;
+	}
+	
+	
+	void
+	world::accessor::set_id (int x, int y, int z, unsigned short id)
+	{
+		this->load_chunk (x >> 4, z >> 4)->set_id (x & 0xF, y, z & 0xF, id);
+	}
+	
+	unsigned short
+	world::accessor::get_id (int x, int y, int z)
+	{
+		chunk *ch = this->get_chunk (x >> 4, z >> 4);
+		if (!ch)
+			return 0;
+		return ch->get_id (x & 0xF, y, z & 0xF);
+	}
+	
+	
+	void
+	world::accessor::set_meta (int x, int y, int z, unsigned char val)
+	{
+		this->load_chunk (x >> 4, z >> 4)->set_meta (x & 0xF, y, z & 0xF, val);
+	}
+	
+	unsigned char
+	world::accessor::get_meta (int x, int y, int z)
+	{
+		chunk *ch = this->get_chunk (x >> 4, z >> 4);
+		if (!ch)
+			return 0;
+		return ch->get_meta (x & 0xF, y, z & 0xF);
+	}
+	
+	
+	unsigned char
+	world::accessor::get_block_light (int x, int y, int z)
+	{
+		chunk *ch = this->get_chunk (x >> 4, z >> 4);
+		if (!ch)
+			return 0;
+		return ch->get_block_light (x & 0xF, y, z & 0xF);
+	}
+	
+	unsigned char
+	world::accessor::get_sky_light (int x, int y, int z)
+	{
+		chunk *ch = this->get_chunk (x >> 4, z >> 4);
+		if (!ch)
+			return 0xF;
+		return ch->get_sky_light (x & 0xF, y, z & 0xF);
+	}
+	
+	
+	void
+	world::accessor::set_id_and_meta (int x, int y, int z, unsigned short id,
+		unsigned char meta)
+	{
+		this->load_chunk (x >> 4, z >> 4)->set_id_and_meta (x & 0xF, y, z & 0xF,
+			id, meta);
+	}
+	
+	block_data
+	world::accessor::get_block (int x, int y, int z)
+	{
+		chunk *ch = this->get_chunk (x >> 4, z >> 4);
+		if (!ch)
+			return block_data ();
+		return ch->get_block (x & 0xF, y, z & 0xF);
 	}
 	
 	
@@ -966,7 +1981,7 @@ namespace hCraft {
 	{
 		if (!this->in_bounds (x, y, z)) return;
 		std::lock_guard<std::mutex> guard {this->update_lock};
-		this->updates.emplace_back (x, y, z, id, meta, extra, ptr, pl, physics);
+		this->updates.push (block_update (x, y, z, id, meta, extra, ptr, pl, physics));
 		
 		std::lock_guard<std::mutex> estage_guard {this->estage_lock};
 		this->estage.set (x, y, z, id, meta);